@@ -0,0 +1,766 @@
+// Google Benchmark suite for LuaData.
+//
+// Windows: build the LuaObjectBench project (needs Google Benchmark, e.g. from vcpkg).
+// Linux: the LuaObjectBench target of CMakeLists.txt, which is only added when Google Benchmark is found
+//   cmake -S . -B build && cmake --build build --target LuaObjectBench
+//
+// Bytes per second are measured against the uncompressed size of the serialized payload,
+// items per second count the LuaData nodes of the payload.
+
+#include <benchmark/benchmark.h>
+
+#include "LuaData.hpp"
+#include "LuaBase64.hpp"
+#include "LuaDataView.hpp"
+#include "LuaJson.hpp"
+#include "LuaDocument.hpp"
+#include "LuaThreadPool.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+#include <base64.h>
+
+static std::size_t CountNodes(const LuaData& data)
+{
+	if (data.m_type != DataType_Table)
+		return 1;
+
+	std::size_t v_count = 1;
+	for (const auto& [v_key, v_value] : *data.m_table)
+		v_count += CountNodes(v_key) + CountNodes(v_value);
+
+	return v_count;
+}
+
+static std::string RandomString(std::mt19937& rng, std::size_t length)
+{
+	std::string v_out(length, ' ');
+	for (char& v_char : v_out)
+		v_char = char('a' + rng() % 26);
+
+	return v_out;
+}
+
+// Lua array of numbers and booleans
+static LuaData MakeFlatArray()
+{
+	LuaData::TableType v_table;
+	for (std::int32_t a = 1; a <= 100000; a++)
+	{
+		if (a % 3 == 0)
+			v_table[LuaData(a)] = LuaData(bool(a & 1));
+		else
+			v_table[LuaData(a)] = LuaData(float(a) * 0.5f);
+	}
+
+	return LuaData(std::move(v_table));
+}
+
+// Tables nested deeply, with a few values on every level
+static LuaData MakeDeepNesting()
+{
+	LuaData v_root = LuaData::TableType{};
+	for (std::int32_t a = 0; a < 500; a++)
+	{
+		LuaData::TableType v_level
+		{
+			{ LuaData("depth"), LuaData(a) },
+			{ LuaData("visible"), LuaData(a % 2 == 0) },
+			{ LuaData("child"), std::move(v_root) }
+		};
+
+		v_root = LuaData(std::move(v_level));
+	}
+
+	return v_root;
+}
+
+// Entities with string keys and string values
+static LuaData MakeStringHeavy()
+{
+	std::mt19937 v_rng(1);
+
+	LuaData::TableType v_table;
+	for (std::int32_t a = 1; a <= 20000; a++)
+	{
+		v_table[LuaData(a)] = LuaData::TableType
+		{
+			{ LuaData("uuid"), LuaData(RandomString(v_rng, 36)) },
+			{ LuaData("name"), LuaData(RandomString(v_rng, 12)) },
+			{ LuaData("description"), LuaData(RandomString(v_rng, 64)) }
+		};
+	}
+
+	return LuaData(std::move(v_table));
+}
+
+// Integer keys with numbers of every width
+static LuaData MakeNumberHeavy()
+{
+	std::mt19937 v_rng(2);
+
+	LuaData::TableType v_table;
+	for (std::int32_t a = 0; a < 100000; a++)
+	{
+		const std::int32_t v_key = std::int32_t(v_rng());
+		switch (a % 4)
+		{
+		case 0: v_table[LuaData(v_key)] = LuaData(std::int32_t(v_rng())); break;
+		case 1: v_table[LuaData(v_key)] = LuaData(std::int16_t(v_rng())); break;
+		case 2: v_table[LuaData(v_key)] = LuaData(std::int8_t(v_rng())); break;
+		default: v_table[LuaData(v_key)] = LuaData(float(v_rng()) / 1000.0f); break;
+		}
+	}
+
+	return LuaData(std::move(v_table));
+}
+
+// A few big Json values
+static LuaData MakeLargeJson()
+{
+	std::mt19937 v_rng(3);
+
+	LuaData::TableType v_table;
+	for (std::int32_t a = 1; a <= 16; a++)
+	{
+		LuaData::JsonType v_json = "[";
+		for (int b = 0; b < 2000; b++)
+		{
+			if (b != 0) v_json += ",";
+			v_json += "{\"id\":" + std::to_string(v_rng()) + ",\"tag\":\"" + RandomString(v_rng, 8) + "\"}";
+		}
+		v_json += "]";
+
+		v_table[LuaData(a)] = LuaData(std::move(v_json));
+	}
+
+	return LuaData(std::move(v_table));
+}
+
+struct Payload
+{
+	LuaData m_data;
+	std::vector<std::uint8_t> m_raw;
+	std::vector<std::uint8_t> m_rawV2;
+	std::vector<std::uint8_t> m_rawV3;
+	std::vector<std::uint8_t> m_compressed;
+	std::string m_base64;
+	std::string m_json;
+	std::size_t m_nodeCount;
+};
+
+static const Payload& GetPayload(LuaData(*generator)())
+{
+	static std::vector<std::pair<LuaData(*)(), Payload>> v_cache;
+	for (const auto& [v_gen, v_payload] : v_cache)
+		if (v_gen == generator)
+			return v_payload;
+
+	Payload v_payload;
+	v_payload.m_data = generator();
+	v_payload.m_nodeCount = CountNodes(v_payload.m_data);
+	LuaData::Serialize(v_payload.m_data, v_payload.m_raw, false);
+	LuaData::Serialize(v_payload.m_data, v_payload.m_rawV2, false, FormatVersion_2);
+	LuaData::Serialize(v_payload.m_data, v_payload.m_rawV3, false, FormatVersion_3);
+	LuaData::Serialize(v_payload.m_data, v_payload.m_compressed, true);
+	LuaData::Serialize(v_payload.m_data, v_payload.m_base64);
+	LuaJson::Write(v_payload.m_data, v_payload.m_json);
+
+	v_cache.emplace_back(generator, std::move(v_payload));
+	return v_cache.back().second;
+}
+
+static const std::vector<std::uint8_t>& GetRaw(const Payload& payload, std::int64_t version)
+{
+	switch (version)
+	{
+	case FormatVersion_2: return payload.m_rawV2;
+	case FormatVersion_3: return payload.m_rawV3;
+	default: return payload.m_raw;
+	}
+}
+
+static void SetThroughput(benchmark::State& state, const Payload& payload)
+{
+	state.SetBytesProcessed(std::int64_t(state.iterations()) * std::int64_t(payload.m_raw.size()));
+	state.SetItemsProcessed(std::int64_t(state.iterations()) * std::int64_t(payload.m_nodeCount));
+}
+
+static void BM_SerializeBase64(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+
+	std::string v_out;
+	for (auto _ : state)
+	{
+		LuaData::Serialize(v_payload.m_data, v_out);
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_SerializeBinary(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const bool v_compress = state.range(0) != 0;
+
+	std::vector<std::uint8_t> v_out;
+	for (auto _ : state)
+	{
+		LuaData::Serialize(v_payload.m_data, v_out, v_compress);
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_SerializeVersion(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const FormatVersion v_version = FormatVersion(state.range(0));
+
+	std::vector<std::uint8_t> v_out;
+	for (auto _ : state)
+	{
+		LuaData::Serialize(v_payload.m_data, v_out, false, v_version);
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	SetThroughput(state, v_payload);
+	state.counters["blob_bytes"] = double(v_out.size());
+
+	LuaData::Serialize(v_payload.m_data, v_out, true, v_version);
+	state.counters["compressed_bytes"] = double(v_out.size());
+}
+
+static void BM_DeserializeVersion(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const std::span<const std::byte> v_input = std::as_bytes(std::span(GetRaw(v_payload, state.range(0))));
+
+	for (auto _ : state)
+	{
+		LuaData v_out;
+		LuaData::Deserialize(v_input, v_out, false);
+		benchmark::DoNotOptimize(v_out.m_type);
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_SerializeParallel(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+
+	LuaThreadPool v_pool(std::size_t(state.range(0)));
+	std::vector<std::uint8_t> v_out;
+	for (auto _ : state)
+	{
+		LuaData::Serialize(v_payload.m_data, v_out, false, FormatVersion_1, &v_pool);
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_SerializeCodec(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+
+	CompressionOptions v_options;
+	v_options.m_codec = CompressionCodec(state.range(0));
+	v_options.m_level = int(state.range(1));
+
+	std::vector<std::uint8_t> v_out;
+	for (auto _ : state)
+	{
+		LuaData::Serialize(v_payload.m_data, v_out, v_options);
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	SetThroughput(state, v_payload);
+	state.counters["compressed_bytes"] = double(v_out.size());
+}
+
+static void BM_DeserializeCodec(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+
+	CompressionOptions v_options;
+	v_options.m_codec = CompressionCodec(state.range(0));
+	v_options.m_level = int(state.range(1));
+
+	std::vector<std::uint8_t> v_input;
+	LuaData::Serialize(v_payload.m_data, v_input, v_options);
+
+	for (auto _ : state)
+	{
+		LuaData v_out;
+		LuaData::Deserialize(std::as_bytes(std::span(v_input)), v_out);
+		benchmark::DoNotOptimize(v_out.m_type);
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+// Base64 alone on the compressed blob, bytes per second are measured against the size of the blob.
+// A kernel of -1 is base64_encode/base64_decode of Dependencies
+static void BM_Base64Encode(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const std::vector<std::uint8_t>& v_input = v_payload.m_compressed;
+
+	const LuaBase64::Kernel v_kernel = LuaBase64::Kernel(std::max<std::int64_t>(state.range(0), 0));
+
+	std::string v_out(LuaBase64::GetEncodedSize(v_input.size()), '\0');
+	for (auto _ : state)
+	{
+		if (state.range(0) < 0)
+			v_out = base64_encode(v_input.data(), v_input.size(), false);
+		else
+			LuaBase64::Encode(v_input, v_out.data(), v_kernel);
+
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	state.SetBytesProcessed(std::int64_t(state.iterations()) * std::int64_t(v_input.size()));
+}
+
+static void BM_Base64Decode(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const std::string& v_input = v_payload.m_base64;
+	const LuaBase64::Kernel v_kernel = LuaBase64::Kernel(std::max<std::int64_t>(state.range(0), 0));
+
+	std::vector<std::uint8_t> v_out(LuaBase64::GetMaxDecodedSize(v_input.size()));
+	for (auto _ : state)
+	{
+		if (state.range(0) < 0)
+		{
+			const std::string v_decoded = base64_decode(v_input, false);
+			benchmark::DoNotOptimize(v_decoded.data());
+		}
+		else
+		{
+			std::size_t v_size;
+			LuaBase64::Decode(v_input, v_out.data(), v_size, v_kernel);
+			benchmark::DoNotOptimize(v_out.data());
+		}
+	}
+
+	state.SetBytesProcessed(std::int64_t(state.iterations()) * std::int64_t(v_payload.m_compressed.size()));
+}
+
+static void BM_DeserializeBase64(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+
+	for (auto _ : state)
+	{
+		LuaData v_out;
+		LuaData::Deserialize(v_payload.m_base64, v_out);
+		benchmark::DoNotOptimize(v_out.m_type);
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_DeserializeBinary(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const bool v_compressed = state.range(0) != 0;
+	const std::vector<std::uint8_t>& v_input = v_compressed ? v_payload.m_compressed : v_payload.m_raw;
+
+	for (auto _ : state)
+	{
+		LuaData v_out;
+		LuaData::Deserialize(std::as_bytes(std::span(v_input)), v_out, v_compressed);
+		benchmark::DoNotOptimize(v_out.m_type);
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_SerializeStack(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const bool v_iterative = state.range(0) != 0;
+
+	std::vector<std::uint8_t> v_out;
+	for (auto _ : state)
+	{
+		if (v_iterative)
+			LuaData::SerializeIterative(v_payload.m_data, v_out, false);
+		else
+			LuaData::Serialize(v_payload.m_data, v_out, false);
+
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_DeserializeStack(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const bool v_iterative = state.range(0) != 0;
+	const std::span<const std::byte> v_input = std::as_bytes(std::span(v_payload.m_raw));
+
+	for (auto _ : state)
+	{
+		LuaData v_out;
+		if (v_iterative)
+			LuaData::DeserializeIterative(v_input, v_out, false);
+		else
+			LuaData::Deserialize(v_input, v_out, false);
+
+		benchmark::DoNotOptimize(v_out.m_type);
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+// Compare with BM_DeserializeBinary
+static void BM_Validate(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const bool v_compressed = state.range(0) != 0;
+	const std::vector<std::uint8_t>& v_input = v_compressed ? v_payload.m_compressed : GetRaw(v_payload, state.range(1));
+
+	for (auto _ : state)
+	{
+		ValidateResult v_result;
+		LuaData::Validate(std::as_bytes(std::span(v_input)), v_compressed, ValidateLimits(), v_result);
+		benchmark::DoNotOptimize(v_result.m_memoryEstimate);
+	}
+
+	SetThroughput(state, v_payload);
+
+	// Memory of the decoded tree
+	ValidateResult v_result;
+	LuaData::Validate(std::as_bytes(std::span(v_input)), v_compressed, ValidateLimits(), v_result);
+	state.counters["tree_bytes"] = double(v_result.m_memoryEstimate);
+}
+
+static void BM_DeserializeDocument(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const std::span<const std::byte> v_input = std::as_bytes(std::span(v_payload.m_raw));
+
+	// The document is reused, just like a server would decode one blob after another
+	LuaDocument v_document;
+	for (auto _ : state)
+	{
+		v_document.deserialize(v_input, false);
+		benchmark::DoNotOptimize(v_document.getRoot().m_type);
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_DeserializeParallel(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const std::vector<std::uint8_t>& v_raw = GetRaw(v_payload, state.range(1));
+	const std::span<const std::byte> v_input = std::as_bytes(std::span(v_raw));
+
+	LuaThreadPool v_pool(std::size_t(state.range(0)));
+	for (auto _ : state)
+	{
+		LuaData v_out;
+		LuaData::Deserialize(v_input, v_out, false, std::pmr::get_default_resource(), nullptr, &v_pool);
+		benchmark::DoNotOptimize(v_out.m_type);
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+// The entities of MakeStringHeavy as separate objects
+static const std::vector<LuaData>& GetSmallObjects()
+{
+	static std::vector<LuaData> v_objects;
+	if (v_objects.empty())
+	{
+		const Payload& v_payload = GetPayload(MakeStringHeavy);
+		v_objects.assign(v_payload.m_data.m_table->getArrayPart().begin(), v_payload.m_data.m_table->getArrayPart().end());
+	}
+
+	return v_objects;
+}
+
+static void BM_SerializeEach(benchmark::State& state)
+{
+	const std::vector<LuaData>& v_objects = GetSmallObjects();
+	const bool v_compress = state.range(0) != 0;
+
+	std::vector<std::uint8_t> v_out;
+	for (auto _ : state)
+	{
+		for (const LuaData& v_object : v_objects)
+		{
+			LuaData::Serialize(v_object, v_out, v_compress);
+			benchmark::DoNotOptimize(v_out.data());
+		}
+	}
+
+	state.SetItemsProcessed(std::int64_t(state.iterations()) * std::int64_t(v_objects.size()));
+}
+
+static void BM_SerializeDictionary(benchmark::State& state)
+{
+	const std::vector<LuaData>& v_objects = GetSmallObjects();
+
+	// The dictionary is trained on objects that aren't part of the measured ones
+	LuaCompressor v_compressor;
+	if (state.range(0) != 0)
+	{
+		std::mt19937 v_rng(4);
+
+		std::vector<LuaData> v_samples;
+		for (int a = 0; a < 64; a++)
+		{
+			v_samples.push_back(LuaData::TableType
+			{
+				{ LuaData("uuid"), LuaData(RandomString(v_rng, 36)) },
+				{ LuaData("name"), LuaData(RandomString(v_rng, 12)) },
+				{ LuaData("description"), LuaData(RandomString(v_rng, 64)) }
+			});
+		}
+
+		std::vector<std::uint8_t> v_dictionary;
+		LuaData::BuildDictionary(v_samples, v_dictionary);
+		v_compressor.setDictionary(std::as_bytes(std::span(v_dictionary)));
+	}
+
+	std::vector<std::uint8_t> v_out;
+	std::size_t v_compressed_sz = 0;
+	for (auto _ : state)
+	{
+		v_compressed_sz = 0;
+		for (const LuaData& v_object : v_objects)
+		{
+			LuaData::Serialize(v_object, v_out, v_compressor);
+			v_compressed_sz += v_out.size();
+		}
+	}
+
+	state.counters["compressed_bytes"] = double(v_compressed_sz);
+	state.SetItemsProcessed(std::int64_t(state.iterations()) * std::int64_t(v_objects.size()));
+}
+
+static void BM_SerializeBatch(benchmark::State& state)
+{
+	const std::vector<LuaData>& v_objects = GetSmallObjects();
+	const bool v_compress = state.range(0) != 0;
+
+	// No pool for 0 threads
+	std::unique_ptr<LuaThreadPool> v_pool;
+	if (state.range(1) != 0)
+		v_pool = std::make_unique<LuaThreadPool>(std::size_t(state.range(1)));
+
+	LuaBlobBatch v_batch;
+	for (auto _ : state)
+	{
+		LuaData::SerializeBatch(v_objects, v_batch, v_compress, FormatVersion_1, v_pool.get());
+		benchmark::DoNotOptimize(v_batch.m_data.data());
+	}
+
+	state.SetItemsProcessed(std::int64_t(state.iterations()) * std::int64_t(v_objects.size()));
+}
+
+static void BM_DeserializeBatch(benchmark::State& state)
+{
+	const std::vector<LuaData>& v_objects = GetSmallObjects();
+	const bool v_compressed = state.range(0) != 0;
+
+	std::unique_ptr<LuaThreadPool> v_pool;
+	if (state.range(1) != 0)
+		v_pool = std::make_unique<LuaThreadPool>(std::size_t(state.range(1)));
+
+	LuaBlobBatch v_batch;
+	LuaData::SerializeBatch(v_objects, v_batch, v_compressed);
+
+	std::vector<LuaData> v_out;
+	for (auto _ : state)
+	{
+		LuaData::DeserializeBatch(v_batch, v_out, v_compressed, std::pmr::get_default_resource(), v_pool.get());
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	state.SetItemsProcessed(std::int64_t(state.iterations()) * std::int64_t(v_objects.size()));
+}
+
+static void BM_ViewLookup(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const std::vector<std::uint8_t>& v_raw = GetRaw(v_payload, state.range(0));
+	const std::span<const std::byte> v_input = std::as_bytes(std::span(v_raw));
+
+	// The last key of the root table is the worst case, every entry in front of it is skipped
+	LuaData v_last_key;
+	for (const auto& [v_key, v_value] : *v_payload.m_data.m_table)
+		v_last_key = v_key;
+
+	for (auto _ : state)
+	{
+		LuaDataView v_root, v_value;
+		bool v_found = LuaDataView::Open(v_input, v_root);
+
+		if (v_last_key.m_type == DataType_Int32)
+			v_found = v_found && v_root.find(v_last_key.m_int32, v_value);
+		else
+			v_found = v_found && v_root.find(v_last_key.getString(), v_value);
+
+		benchmark::DoNotOptimize(v_found);
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_ToString(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+
+	ToStringOptions v_options;
+	v_options.m_indent = std::size_t(state.range(0));
+
+	// 0 formats into a new string, 1 reserves it first, 2 reuses the capacity of the last one
+	const std::int64_t v_buffer_mode = state.range(1);
+	std::string v_out;
+
+	for (auto _ : state)
+	{
+		if (v_buffer_mode == 2)
+			v_out.clear();
+		else
+			v_out = std::string();
+
+		if (v_buffer_mode == 1)
+			v_out.reserve(v_payload.m_data.getStringSize(v_options));
+
+		v_payload.m_data.toString(v_out, v_options);
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+// Compare with BM_ToString
+static void BM_JsonWrite(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	std::string v_out;
+
+	for (auto _ : state)
+	{
+		v_out.clear();
+		LuaJson::Write(v_payload.m_data, v_out);
+		benchmark::DoNotOptimize(v_out.data());
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_JsonRead(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+
+	for (auto _ : state)
+	{
+		LuaData v_data;
+		LuaJson::Read(v_payload.m_json, v_data);
+		benchmark::DoNotOptimize(v_data);
+	}
+
+	SetThroughput(state, v_payload);
+}
+
+static void BM_GetHash(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const LuaData::TableType& v_table = *v_payload.m_data.m_table;
+
+	for (auto _ : state)
+	{
+		std::size_t v_hash = 0;
+		for (const auto& [v_key, v_value] : v_table)
+			v_hash ^= v_key.getHash() ^ v_value.getHash();
+
+		benchmark::DoNotOptimize(v_hash);
+	}
+
+	state.SetItemsProcessed(std::int64_t(state.iterations()) * std::int64_t(v_table.size() * 2));
+}
+
+static void BM_TableLookup(benchmark::State& state, LuaData(*generator)())
+{
+	const Payload& v_payload = GetPayload(generator);
+	const LuaData::TableType& v_table = *v_payload.m_data.m_table;
+
+	std::vector<LuaData> v_keys;
+	for (const auto& [v_key, v_value] : v_table)
+		v_keys.push_back(v_key);
+
+	std::shuffle(v_keys.begin(), v_keys.end(), std::mt19937(4));
+
+	for (auto _ : state)
+	{
+		std::size_t v_found = 0;
+		for (const LuaData& v_key : v_keys)
+			v_found += v_table.contains(v_key);
+
+		benchmark::DoNotOptimize(v_found);
+	}
+
+	state.SetItemsProcessed(std::int64_t(state.iterations()) * std::int64_t(v_keys.size()));
+}
+
+#define LUA_BENCHMARK_PAYLOADS(func, ...) \
+	BENCHMARK_CAPTURE(func, FlatArray, MakeFlatArray)__VA_ARGS__; \
+	BENCHMARK_CAPTURE(func, DeepNesting, MakeDeepNesting)__VA_ARGS__; \
+	BENCHMARK_CAPTURE(func, StringHeavy, MakeStringHeavy)__VA_ARGS__; \
+	BENCHMARK_CAPTURE(func, NumberHeavy, MakeNumberHeavy)__VA_ARGS__; \
+	BENCHMARK_CAPTURE(func, LargeJson, MakeLargeJson)__VA_ARGS__
+
+LUA_BENCHMARK_PAYLOADS(BM_SerializeBase64);
+LUA_BENCHMARK_PAYLOADS(BM_SerializeBinary, ->ArgName("compress")->Arg(0)->Arg(1));
+LUA_BENCHMARK_PAYLOADS(BM_SerializeVersion, ->ArgName("version")->Arg(FormatVersion_1)->Arg(FormatVersion_2)->Arg(FormatVersion_3));
+LUA_BENCHMARK_PAYLOADS(BM_DeserializeVersion, ->ArgName("version")->Arg(FormatVersion_1)->Arg(FormatVersion_2)->Arg(FormatVersion_3));
+LUA_BENCHMARK_PAYLOADS(BM_SerializeParallel, ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime());
+// Codec and its acceleration or level
+#define LUA_BENCHMARK_CODECS \
+	->ArgNames({ "codec", "level" }) \
+	->Args({ CompressionCodec_None, 0 }) \
+	->Args({ CompressionCodec_LZ4, 1 })->Args({ CompressionCodec_LZ4, 8 }) \
+	->Args({ CompressionCodec_LZ4HC, 4 })->Args({ CompressionCodec_LZ4HC, 9 })->Args({ CompressionCodec_LZ4HC, 12 })
+LUA_BENCHMARK_PAYLOADS(BM_SerializeCodec, LUA_BENCHMARK_CODECS);
+LUA_BENCHMARK_PAYLOADS(BM_DeserializeCodec, LUA_BENCHMARK_CODECS);
+LUA_BENCHMARK_PAYLOADS(BM_Base64Encode, ->ArgName("kernel")->Arg(-1)->Arg(LuaBase64::Kernel_Scalar)
+	->Arg(LuaBase64::Kernel_SSSE3)->Arg(LuaBase64::Kernel_AVX2));
+LUA_BENCHMARK_PAYLOADS(BM_Base64Decode, ->ArgName("kernel")->Arg(-1)->Arg(LuaBase64::Kernel_Scalar)
+	->Arg(LuaBase64::Kernel_SSSE3)->Arg(LuaBase64::Kernel_AVX2));
+LUA_BENCHMARK_PAYLOADS(BM_DeserializeBase64);
+LUA_BENCHMARK_PAYLOADS(BM_DeserializeBinary, ->ArgName("compressed")->Arg(0)->Arg(1));
+LUA_BENCHMARK_PAYLOADS(BM_SerializeStack, ->ArgName("iterative")->Arg(0)->Arg(1));
+LUA_BENCHMARK_PAYLOADS(BM_DeserializeStack, ->ArgName("iterative")->Arg(0)->Arg(1));
+LUA_BENCHMARK_PAYLOADS(BM_Validate, ->ArgNames({ "compressed", "version" })
+	->Args({ 0, FormatVersion_1 })->Args({ 0, FormatVersion_2 })->Args({ 0, FormatVersion_3 })->Args({ 1, FormatVersion_1 }));
+LUA_BENCHMARK_PAYLOADS(BM_DeserializeDocument);
+LUA_BENCHMARK_PAYLOADS(BM_DeserializeParallel, ->ArgNames({ "threads", "version" })
+	->ArgsProduct({ { 1, 2, 4, 8 }, { FormatVersion_1, FormatVersion_2, FormatVersion_3 } })->UseRealTime());
+LUA_BENCHMARK_PAYLOADS(BM_ViewLookup, ->ArgName("version")->Arg(FormatVersion_1)->Arg(FormatVersion_2)->Arg(FormatVersion_3));
+LUA_BENCHMARK_PAYLOADS(BM_ToString, ->ArgNames({ "indent", "buffer" })->ArgsProduct({ { 0, 2 }, { 0, 1, 2 } }));
+LUA_BENCHMARK_PAYLOADS(BM_JsonWrite);
+LUA_BENCHMARK_PAYLOADS(BM_JsonRead);
+LUA_BENCHMARK_PAYLOADS(BM_GetHash);
+LUA_BENCHMARK_PAYLOADS(BM_TableLookup);
+
+BENCHMARK(BM_SerializeEach)->ArgName("compress")->Arg(0)->Arg(1);
+BENCHMARK(BM_SerializeDictionary)->ArgName("dictionary")->Arg(0)->Arg(1);
+BENCHMARK(BM_SerializeBatch)->ArgNames({ "compress", "threads" })->ArgsProduct({ { 0, 1 }, { 0, 4 } })->UseRealTime();
+BENCHMARK(BM_DeserializeBatch)->ArgNames({ "compressed", "threads" })->ArgsProduct({ { 0, 1 }, { 0, 4 } })->UseRealTime();
+
+BENCHMARK_MAIN();
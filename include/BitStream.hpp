@@ -1,15 +1,58 @@
 #pragma once
 
+#include <type_traits>
+#include <algorithm>
+#include <cstring>
 #include <cstdint>
 #include <cstddef>
 #include <vector>
 #include <memory>
+#include <bit>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Unsigned integer type with the same size as T
+template<typename T>
+using UIntOfSize = std::conditional_t<sizeof(T) == 1, std::uint8_t,
+	std::conditional_t<sizeof(T) == 2, std::uint16_t,
+	std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>>>;
+
+template<typename T>
+inline T ByteSwap(T value)
+{
+	if constexpr (sizeof(T) == 1)
+		return value;
+#if defined(_MSC_VER)
+	else if constexpr (sizeof(T) == 2)
+		return T(_byteswap_ushort(std::uint16_t(value)));
+	else if constexpr (sizeof(T) == 4)
+		return T(_byteswap_ulong(std::uint32_t(value)));
+	else
+		return T(_byteswap_uint64(std::uint64_t(value)));
+#else
+	else if constexpr (sizeof(T) == 2)
+		return T(__builtin_bswap16(std::uint16_t(value)));
+	else if constexpr (sizeof(T) == 4)
+		return T(__builtin_bswap32(std::uint32_t(value)));
+	else
+		return T(__builtin_bswap64(std::uint64_t(value)));
+#endif
+}
+
+// Reads bits starting from the most significant bit of every byte. Every read loads a 64 bit
+// window at the current byte with an unaligned load and shifts the requested bits out of it,
+// so the reader has no state besides m_dataIndex, which can be moved freely.
 class BitReader
 {
 public:
 	BitReader(const void* data_ptr, std::size_t data_size);
 
+	// Points the reader to a new buffer without touching the current index, which allows
+	// a reader to continue once more data was appended to (or moved within) its buffer
+	void setData(const void* data_ptr, std::size_t data_size);
+
 	bool isEnoughData(std::size_t bit_count) const;
 
 	bool readBitAtIdx(std::size_t cur_bit) const;
@@ -17,66 +60,274 @@ public:
 
 	bool readBits(void* data_ptr, std::size_t bit_count, const bool align_right = false);
 
+	// Reads bit_count (1..64) bits into the lowest bits of the value, most significant bit first
+	inline bool readValue(std::uint64_t* pValue, std::size_t bit_count)
+	{
+		if (!this->isEnoughData(bit_count))
+			return false;
+
+		const std::size_t v_bit_offset = m_dataIndex & 7;
+		std::uint64_t v_window = this->loadWindow(m_dataIndex >> 3) << v_bit_offset;
+
+		// The window only has 64 - v_bit_offset valid bits, fetch the rest from the next byte
+		if (bit_count > 64 - v_bit_offset)
+			v_window |= std::uint64_t(m_dataPtr[(m_dataIndex >> 3) + 8]) >> (8 - v_bit_offset);
+
+		*pValue = v_window >> (64 - bit_count);
+		m_dataIndex += bit_count;
+		return true;
+	}
+
+	// See BitWriter::writeVarUInt. Fails on more than 64 bits
+	inline bool readVarUInt(std::uint64_t* pValue)
+	{
+		// Values with up to 8 groups are found in one window, without a branch per group
+		std::uint64_t v_window;
+		if (this->readValue(&v_window, 64))
+		{
+			const std::uint64_t v_last_groups = ~v_window & 0x8080808080808080;
+			if (v_last_groups != 0)
+			{
+				const std::size_t v_group_count = std::size_t(std::countl_zero(v_last_groups)) / 8 + 1;
+				m_dataIndex -= 64 - 8 * v_group_count;
+
+				// Group i ends up in byte i, then the 7 bit groups are pulled together in 3 steps
+				std::uint64_t v_value = ByteSwap(v_window & (~std::uint64_t(0) << (64 - 8 * v_group_count))) & 0x7F7F7F7F7F7F7F7F;
+				v_value = (v_value & 0x007F007F007F007F) | ((v_value & 0x7F007F007F007F00) >> 1);
+				v_value = (v_value & 0x00003FFF00003FFF) | ((v_value & 0x3FFF00003FFF0000) >> 2);
+				v_value = (v_value & 0x000000000FFFFFFF) | ((v_value & 0x0FFFFFFF00000000) >> 4);
+
+				*pValue = v_value;
+				return true;
+			}
+
+			m_dataIndex -= 64;
+		}
+
+		std::uint64_t v_value = 0;
+		for (std::size_t v_shift = 0; v_shift < 64; v_shift += 7)
+		{
+			std::uint64_t v_group;
+			if (!this->readValue(&v_group, 8))
+				return false;
+
+			// The 10th group only has 1 bit left
+			if (v_shift == 63 && (v_group & 0x7E) != 0)
+				return false;
+
+			v_value |= (v_group & 0x7F) << v_shift;
+			if ((v_group & 0x80) == 0)
+			{
+				*pValue = v_value;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Whether all groups of the varint at the current index are in the data, so a readVarUInt
+	// that fails anyway means that the varint is malformed rather than cut off
+	inline bool isVarUIntComplete() const
+	{
+		for (std::size_t a = 0; a < 10; a++)
+		{
+			if (!this->isEnoughData((a + 1) * 8))
+				return false;
+
+			if (!this->readBitAtIdx(m_dataIndex + a * 8))
+				return true;
+		}
+
+		return true;
+	}
+
+	inline bool readVarInt(std::int64_t* pValue)
+	{
+		std::uint64_t v_value;
+		if (!this->readVarUInt(&v_value))
+			return false;
+
+		*pValue = std::int64_t((v_value >> 1) ^ (0 - (v_value & 1)));
+		return true;
+	}
+
 	void alignIndex();
 
 	template<typename T, bool t_big_endian = false>
 	inline bool readObject(T* pObject)
 	{
-		if (!readBits(pObject, sizeof(T) * 8))
-			return false;
+		using UIntType = UIntOfSize<T>;
+		static_assert(sizeof(T) <= 8 && sizeof(T) == sizeof(UIntType));
 
-		if constexpr (t_big_endian && sizeof(T) > 1)
-		{
-			std::uint8_t* v_begin = reinterpret_cast<std::uint8_t*>(pObject);
-			std::uint8_t* v_end = v_begin + sizeof(T);
+		std::uint64_t v_value;
+		if (!this->readValue(&v_value, sizeof(T) * 8))
+			return false;
 
-			std::reverse(v_begin, v_end);
-		}
+		// readValue returns the bytes in big endian order
+		UIntType v_object = UIntType(v_value);
+		if constexpr (!t_big_endian)
+			v_object = ByteSwap(v_object);
 
+		*pObject = std::bit_cast<T>(v_object);
 		return true;
 	}
 
 	const std::uint8_t* m_dataPtr;
 	std::size_t m_dataSize; // Size in bits
 	std::size_t m_dataIndex; // Current index in the data
+
+private:
+	// Big endian 64 bit word at the byte, padded with zeroes past the end of the data
+	inline std::uint64_t loadWindow(std::size_t byte_idx) const
+	{
+		const std::size_t v_byte_count = m_dataSize >> 3;
+
+		std::uint64_t v_word = 0;
+		if (byte_idx + 8 <= v_byte_count)
+			std::memcpy(&v_word, m_dataPtr + byte_idx, sizeof(v_word));
+		else if (byte_idx < v_byte_count)
+			std::memcpy(&v_word, m_dataPtr + byte_idx, v_byte_count - byte_idx);
+
+		if constexpr (std::endian::native == std::endian::little)
+			v_word = ByteSwap(v_word);
+
+		return v_word;
+	}
 };
 
+// Collects the bits in a 64 bit register and only writes whole words into the buffer.
+// The bits are written starting from the most significant bit of every byte.
+// Call flush() before reading m_data; writing can continue after it.
 class BitWriter
 {
 public:
 	BitWriter();
+	BitWriter(std::size_t reserve_size);
 	~BitWriter() = default;
 
+	inline void reserve(std::size_t byte_count)
+	{
+		m_data.reserve(byte_count);
+	}
+
 	void writeBits(const void* data_ptr, std::size_t bit_count, const bool align_right = false);
 
-	template<typename T, bool t_big_endian = false>
-	inline void writeObject(T obj)
+	// Writes the lowest bit_count (1..64) bits of the value, most significant bit first.
+	// The bits above bit_count have to be zero
+	inline void writeValue(std::uint64_t value, std::size_t bit_count)
 	{
-		if constexpr (t_big_endian && sizeof(T) > 1)
+		if (m_cacheBits == 0 && (m_dataIndex & 7) != 0)
+			this->reloadCache();
+
+		const std::size_t v_free_bits = 64 - m_cacheBits;
+		if (bit_count < v_free_bits)
+		{
+			m_cache |= value << (v_free_bits - bit_count);
+			m_cacheBits += bit_count;
+		}
+		else
 		{
-			std::uint8_t* v_begin = reinterpret_cast<std::uint8_t*>(&obj);
-			std::uint8_t* v_end = v_begin + sizeof(T);
+			const std::size_t v_rest_bits = bit_count - v_free_bits;
 
-			std::reverse(v_begin, v_end);
+			m_cache |= value >> v_rest_bits;
+			this->flushCache();
+
+			m_cache = (v_rest_bits != 0) ? (value << (64 - v_rest_bits)) : 0;
+			m_cacheBits = v_rest_bits;
 		}
 
-		this->writeBits(&obj, sizeof(T) * 8);
+		m_dataIndex += bit_count;
+	}
+
+	template<typename T, bool t_big_endian = false>
+	inline void writeObject(T obj)
+	{
+		using UIntType = UIntOfSize<T>;
+		static_assert(sizeof(T) <= 8 && sizeof(T) == sizeof(UIntType));
+
+		// writeValue goes from the most significant byte, which is the big endian order
+		UIntType v_value = std::bit_cast<UIntType>(obj);
+		if constexpr (!t_big_endian)
+			v_value = ByteSwap(v_value);
+
+		this->writeValue(std::uint64_t(v_value), sizeof(T) * 8);
 	}
 
 	inline void writeBit(bool bit)
 	{
-		this->writeBits(&bit, 1, true);
+		this->writeValue(std::uint64_t(bit), 1);
+	}
+
+	// Groups of 7 bits, the least significant one first. Every group is preceded by a bit that
+	// tells whether another group follows, so values below 128 take 8 bits
+	inline void writeVarUInt(std::uint64_t value)
+	{
+		// Values with up to 8 groups are written at once, without a branch per group
+		if (value >= (std::uint64_t(1) << 56))
+		{
+			this->writeValue(0x80 | (value & 0x7F), 8);
+			this->writeVarUInt(value >> 7);
+			return;
+		}
+
+		const std::size_t v_group_count = std::max<std::size_t>(1, (std::size_t(std::bit_width(value)) + 6) / 7);
+
+		// Group i goes into byte i in 3 steps, all but the last one get the continuation bit
+		std::uint64_t v_groups = (value & 0x000000000FFFFFFF) | ((value & 0x00FFFFFFF0000000) << 4);
+		v_groups = (v_groups & 0x00003FFF00003FFF) | ((v_groups & 0x0FFFC0000FFFC000) << 2);
+		v_groups = (v_groups & 0x007F007F007F007F) | ((v_groups & 0x3F803F803F803F80) << 1);
+
+		v_groups |= 0x8080808080808080 & ((std::uint64_t(1) << (8 * (v_group_count - 1))) - 1);
+
+		// writeValue starts with the most significant byte, which has to be the first group
+		this->writeValue(ByteSwap(v_groups) >> (64 - 8 * v_group_count), 8 * v_group_count);
+	}
+
+	// Zigzag encoded, so small negative values take as few bits as small positive ones
+	inline void writeVarInt(std::int64_t value)
+	{
+		this->writeVarUInt((std::uint64_t(value) << 1) ^ std::uint64_t(value >> 63));
 	}
 
 	inline void alignIndex()
 	{
+		m_alignCount++;
+
 		const std::size_t v_offset = m_dataIndex & 7;
 		if (v_offset == 0)
 			return;
 
-		m_dataIndex += (8 - v_offset);
+		const std::size_t v_padding = 8 - v_offset;
+		m_dataIndex += v_padding;
+
+		// Without cached bits the padding is already part of the last byte in the buffer
+		if (m_cacheBits == 0)
+			return;
+
+		m_cacheBits += v_padding;
+		if (m_cacheBits == 64)
+			this->flushCache();
 	}
 
+	// Appends bit_count bits of the data starting at bit_offset, e.g. the output of another writer
+	void appendBits(const void* data_ptr, std::size_t bit_offset, std::size_t bit_count);
+
+	// Writes the cached bits into m_data, the last byte is padded with zeroes
+	void flush();
+
+	// Overwrites bit_count bits that were already written, e.g. a size that is only known afterwards
+	void patchValue(std::size_t bit_index, std::uint64_t value, std::size_t bit_count);
+
 	std::size_t m_dataIndex;
 	std::vector<std::uint8_t> m_data;
+	// Number of alignIndex calls. Without any, the bits don't depend on where the writer started
+	std::size_t m_alignCount;
+
+private:
+	void flushCache();
+	void reloadCache();
+
+	std::uint64_t m_cache;
+	std::size_t m_cacheBits;
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory_resource>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Interned string. Every pool stores a string only once, so atoms of the same pool can
+// be compared by their address. The hash is the same as std::hash<std::string_view>.
+struct LuaAtom
+{
+	std::string_view m_string;
+	std::size_t m_hash;
+};
+
+// Set of atoms. Atoms and their characters stay valid until the pool is cleared or destroyed.
+class LuaAtomPool
+{
+public:
+	LuaAtomPool(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	LuaAtomPool(const LuaAtomPool&) = delete;
+	~LuaAtomPool() = default;
+
+	LuaAtomPool& operator=(const LuaAtomPool&) = delete;
+
+	// Returns the atom of the string, the string is only copied the first time it's seen
+	const LuaAtom* intern(std::string_view str);
+	// Returns nullptr when the string isn't in the pool
+	const LuaAtom* find(std::string_view str) const;
+
+	// Invalidates all of the atoms of the pool
+	void clear();
+
+	inline std::size_t size() const { return m_count; }
+
+	// Pool of the calling thread. Its atoms live until the thread exits
+	static LuaAtomPool& GetThreadPool();
+
+private:
+	std::size_t findSlot(std::string_view str, std::size_t hash) const;
+	void rehash(std::size_t slot_count);
+
+	// Atoms are never freed one by one, so they are bump allocated
+	std::pmr::monotonic_buffer_resource m_storage;
+	std::pmr::vector<const LuaAtom*> m_slots;
+	std::size_t m_count;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <span>
+
+// Base64 with the standard alphabet and '=' padding, encoded and decoded 12 or 24 bytes at a
+// time with SSSE3 or AVX2 when the CPU has them. The kernel is picked once at runtime, the
+// scalar one handles the tails and every other CPU.
+//
+// The output is the same as the one of base64_encode/base64_decode in Dependencies. Decoding is
+// just as liberal: the url alphabet, '.' padding and missing padding are accepted as well.
+class LuaBase64
+{
+public:
+	enum Kernel : std::uint8_t
+	{
+		Kernel_Scalar = 0,
+		Kernel_SSSE3  = 1,
+		Kernel_AVX2   = 2
+	};
+
+	// The best kernel the CPU supports
+	static Kernel GetKernel();
+
+	static constexpr std::size_t GetEncodedSize(std::size_t size) { return (size + 2) / 3 * 4; }
+	// Upper limit, the padding makes the decoded data up to 2 bytes smaller
+	static constexpr std::size_t GetMaxDecodedSize(std::size_t size) { return (size + 3) / 4 * 3; }
+
+	// Writes exactly GetEncodedSize(data.size()) characters to out_data
+	static void Encode(std::span<const std::uint8_t> data, char* out_data, Kernel kernel = LuaBase64::GetKernel());
+	// Writes up to GetMaxDecodedSize(data.size()) bytes to out_data. Fails on characters outside
+	// of the alphabet, padding that isn't at the end and a dangling character
+	static bool Decode(std::string_view data, std::uint8_t* out_data, std::size_t& out_size, Kernel kernel = LuaBase64::GetKernel());
+
+	// The output is overwritten and its capacity is reused
+	static void Encode(std::span<const std::uint8_t> data, std::string& out_data);
+	static bool Decode(std::string_view data, std::vector<std::uint8_t>& out_data);
+};
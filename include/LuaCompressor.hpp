@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <span>
+
+union LZ4_stream_u;
+union LZ4_streamHC_u;
+
+enum CompressionCodec : std::uint8_t
+{
+	// The data is stored as it is
+	CompressionCodec_None  = 0,
+	CompressionCodec_LZ4   = 1,
+	// Slower, but compresses better. The blocks are decompressed just like CompressionCodec_LZ4
+	CompressionCodec_LZ4HC = 2,
+	// CompressionCodec_None below the size threshold, CompressionCodec_LZ4 otherwise
+	CompressionCodec_Auto  = 3
+};
+
+struct CompressionOptions
+{
+	CompressionCodec m_codec = CompressionCodec_LZ4;
+	// Acceleration of CompressionCodec_LZ4 and CompressionCodec_Auto, higher is faster and compresses less.
+	// Level of CompressionCodec_LZ4HC, from 1 to 12. 0 is the default of the codec, acceleration 1 or level 9
+	int m_level = 0;
+	// Data below this size isn't compressed by CompressionCodec_Auto
+	std::size_t m_minSize = 256;
+};
+
+// LZ4 block compression with a state that's reused between blobs instead of being set up for
+// every one of them.
+//
+// Small blobs that look alike barely compress on their own, but compress well against a
+// dictionary made of typical blobs, see LuaData::BuildDictionary. The dictionary is loaded
+// once and the loaded state is copied for every blob. Blobs compressed with a dictionary can
+// only be decompressed with the same dictionary.
+class LuaCompressor
+{
+public:
+	// LZ4 only looks at the last 64 KB of a dictionary
+	static constexpr std::size_t MaxDictionarySize = 0x10000;
+
+	LuaCompressor();
+	explicit LuaCompressor(std::span<const std::byte> dictionary);
+	LuaCompressor(const LuaCompressor&) = delete;
+	~LuaCompressor() = default;
+
+	LuaCompressor& operator=(const LuaCompressor&) = delete;
+
+	// Copies the dictionary, an empty one turns it off
+	void setDictionary(std::span<const std::byte> dictionary);
+	inline std::span<const std::byte> getDictionary() const { return std::as_bytes(std::span(m_dictionary)); }
+
+	// Appends the compressed block to out_data, or the data itself for CompressionCodec_None
+	bool compress(std::span<const std::uint8_t> data, std::vector<std::uint8_t>& out_data,
+		const CompressionOptions& options = CompressionOptions());
+	// Fails without allocating when the block would exceed max_size. The buffer keeps its size,
+	// out_size is the used part. It's shrunk back when the block turns out to be corrupted
+	bool decompress(std::span<const std::byte> data, std::vector<std::uint8_t>& out_data, std::size_t& out_size,
+		std::size_t max_size) const;
+
+private:
+	// The block doesn't store its uncompressed size, so it's added up from the lengths of its
+	// sequences without decompressing anything. Offsets that can't be valid fail right away
+	static bool GetDecompressedSize(std::span<const std::byte> data, std::size_t dict_size, std::size_t max_size,
+		std::size_t& out_size);
+	bool compressHC(std::span<const std::uint8_t> data, std::vector<std::uint8_t>& out_data, int level);
+
+	std::vector<std::uint8_t> m_dictionary;
+
+	std::unique_ptr<LZ4_stream_u, int(*)(LZ4_stream_u*)> m_stream;
+	// State right after the dictionary was loaded
+	std::unique_ptr<LZ4_stream_u, int(*)(LZ4_stream_u*)> m_dictStream;
+	// Only created once CompressionCodec_LZ4HC is used
+	std::unique_ptr<LZ4_streamHC_u, int(*)(LZ4_streamHC_u*)> m_streamHC;
+};
@@ -1,8 +1,19 @@
 #pragma once
 
 #include "BitStream.hpp"
+#include "LuaAtom.hpp"
+#include "LuaCompressor.hpp"
+#include "LuaTable.hpp"
+
+#include <memory_resource>
+#include <string_view>
 #include <string>
-#include <map>
+#include <limits>
+#include <atomic>
+#include <mutex>
+#include <span>
+
+class LuaThreadPool;
 
 enum DataType : std::uint8_t
 {
@@ -17,40 +28,126 @@ enum DataType : std::uint8_t
 	DataType_Int8     = 8,
 	DataType_Json     = 9,
 	DataType_Userdata = 100,
-	DataType_Unknown  = 101
+	DataType_Unknown  = 101,
+
+	// Interned string, which is written as DataType_String. Only exists in memory
+	DataType_Atom     = 200
+};
+
+enum FormatVersion : std::uint32_t
+{
+	FormatVersion_1 = 1,
+	// Big tables and tables with nested tables store the size of their entries in bits,
+	// so readers can skip them without decoding a single entry
+	FormatVersion_2 = 2,
+	// FormatVersion_2 with 4 bit type tags and variable-length sizes, counts and integers, see
+	// BitWriter::writeVarUInt. The size of the entries stays 32 bits, it's filled in afterwards
+	FormatVersion_3 = 3
+};
+
+// Blobs written back to back into one buffer, see LuaData::SerializeBatch
+struct LuaBlobBatch
+{
+	std::vector<std::uint8_t> m_data;
+	// Blob i is [m_offsets[i], m_offsets[i + 1]), so there is one more offset than blobs
+	std::vector<std::size_t> m_offsets;
+
+	inline std::size_t size() const { return m_offsets.empty() ? 0 : m_offsets.size() - 1; }
+
+	inline std::span<const std::byte> getBlob(std::size_t idx) const
+	{
+		return std::as_bytes(std::span(m_data.data() + m_offsets[idx], m_offsets[idx + 1] - m_offsets[idx]));
+	}
+
+	// Keeps the capacity of both buffers
+	inline void clear()
+	{
+		m_data.clear();
+		m_offsets.clear();
+	}
+};
+
+// Limits and layout of LuaData::toString, the defaults write everything on one line
+struct ToStringOptions
+{
+	// Tables nested deeper than this are written as "{ ... }", the outermost table is at depth 1
+	std::size_t m_maxDepth = std::numeric_limits<std::size_t>::max();
+	// The output is cut after this many characters, which is marked by "..."
+	std::size_t m_maxLength = std::numeric_limits<std::size_t>::max();
+	// Spaces per nesting level. With any, every entry of a table gets its own line
+	std::size_t m_indent = 0;
+};
+
+// Limits of LuaData::Validate, the defaults only reject blobs that Deserialize rejects as well
+struct ValidateLimits
+{
+	// Nesting of tables, the outermost table is at depth 1
+	std::size_t m_maxDepth = std::numeric_limits<std::size_t>::max();
+	// Values of the whole blob, the keys of tables included
+	std::size_t m_maxValues = std::numeric_limits<std::size_t>::max();
+	// Characters of a single string or Json value
+	std::size_t m_maxStringSize = std::numeric_limits<std::size_t>::max();
+	// Size of the decompressed blob, LuaData::MaxDecompressedSize applies either way
+	std::size_t m_maxDecompressedSize = std::numeric_limits<std::size_t>::max();
+};
+
+struct ValidateResult
+{
+	FormatVersion m_version = FormatVersion_1;
+	// Size of the blob once it's decompressed
+	std::size_t m_dataSize = 0;
+	std::size_t m_valueCount = 0;
+	std::size_t m_tableCount = 0;
+	std::size_t m_maxDepth = 0;
+	// Characters of all strings and Json values
+	std::size_t m_stringSize = 0;
+	// Bytes Deserialize allocates for the tree without an atom pool, not counting the overhead
+	// of the allocator
+	std::size_t m_memoryEstimate = 0;
 };
 
 #pragma warning(push)
 #pragma warning(disable : 26495)
 
-struct JsonString : public std::string
+struct JsonString : public std::pmr::string
 {
-	using std::string::basic_string;
+	using std::pmr::string::basic_string;
 };
 
 struct LuaData
 {
-	using TableType = std::map<LuaData, LuaData>;
+	using TableType = LuaTable<LuaData>;
+	using StringType = std::pmr::string;
 	using JsonType = JsonString;
 
 	LuaData() : m_type(DataType_None) {}
 
-	LuaData(std::string&& str) : m_type(DataType_String), m_string(std::move(str)) {}
-	LuaData(const std::string& str) : m_type(DataType_String), m_string(str) {}
+	LuaData(StringType&& str) : m_type(DataType_String) { this->assignString(std::move(str)); }
+	LuaData(const StringType& str) : m_type(DataType_String) { this->assignString(str, std::pmr::get_default_resource()); }
+
+	LuaData(std::string_view str, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+		: m_type(DataType_String)
+	{
+		this->assignString(str, resource);
+	}
 
-	LuaData(const JsonType& json_str) : m_type(DataType_Json), m_string(json_str) {}
-	LuaData(JsonType&& json_str) : m_type(DataType_Json), m_string(std::move(json_str)) {}
+	LuaData(const JsonType& json_str) : m_type(DataType_Json) { this->assignString(json_str, std::pmr::get_default_resource()); }
+	LuaData(JsonType&& json_str) : m_type(DataType_Json) { this->assignString(std::move(json_str)); }
 
 	template<std::size_t N>
-	LuaData(const char(&const_str)[N]) : m_type(DataType_String), m_string(const_str, N - 1) {}
+	LuaData(const char(&const_str)[N])
+		: m_type(DataType_String)
+	{
+		this->assignString(std::string_view(const_str, N - 1), std::pmr::get_default_resource());
+	}
 
 	LuaData(bool boolean) : m_type(DataType_Boolean), m_boolean(boolean) {}
 
 	LuaData(float num) : m_type(DataType_Number), m_number(num) {}
 
-	LuaData(TableType&& tbl) : m_type(DataType_Table), m_table(std::move(tbl)) {}
+	LuaData(TableType&& tbl) : m_type(DataType_Table) { this->assignTable(std::move(tbl)); }
 
-	LuaData(const TableType& tbl) : m_type(DataType_Table), m_table(tbl) {}
+	LuaData(const TableType& tbl) : m_type(DataType_Table) { this->assignTable(TableType(tbl)); }
 
 	LuaData(std::int32_t num) : m_type(DataType_Int32), m_int32(num) {}
 
@@ -60,6 +157,8 @@ struct LuaData
 
 	LuaData(std::nullptr_t) : m_type(DataType_Nil) {}
 
+	LuaData(const LuaAtom* atom) : m_type(DataType_Atom), m_atom(atom) {}
+
 	LuaData(const LuaData& other)
 		: m_type(other.m_type)
 	{
@@ -78,38 +177,376 @@ struct LuaData
 	}
 
 	void copyAssignData(const LuaData& other);
+	// Leaves other as DataType_None when it owns a string or a table
 	void moveAssignData(LuaData&& other) noexcept;
 	void clearData();
 
 	void operator=(LuaData&& other) noexcept;
 	void operator=(const LuaData& other) noexcept;
 	bool operator<(const LuaData& rhs) const;
+	bool operator==(const LuaData& rhs) const;
 
-	void toString(std::string& out_string) const;
+	// Appends to the string, without any temporary strings
+	void toString(std::string& out_string, const ToStringOptions& options = ToStringOptions()) const;
 	std::string toString2() const;
+	// Size of the output of toString, e.g. to reserve the string up front
+	std::size_t getStringSize(const ToStringOptions& options = ToStringOptions()) const;
 
 	std::size_t getTypeData() const;
+	// The hash of strings and Json values is computed on the first call and cached, tables
+	// are hashed structurally on every call. Equal values always have equal hashes
 	std::size_t getHash() const;
 
+	inline bool isString() const { return m_type == DataType_String || m_type == DataType_Atom; }
+
+	// Characters of strings, atoms and Json values
+	inline std::string_view getString() const
+	{
+		if (m_type == DataType_Atom)
+			return m_atom->m_string;
+
+		return m_isSmallString ? std::string_view(m_smallString, m_smallSize) : std::string_view(*m_string);
+	}
+
+	// Strings and Json values have to be modified through this, so the cached hash is reset.
+	// Small strings are moved into an allocation from the default resource first, atoms are
+	// turned into strings with a copy of their characters
+	StringType& getMutableString();
+
+	// Returns the index of the key in the array part of a table, or 0 if it doesn't belong there
+	inline std::size_t getArrayIndex() const
+	{
+		return (m_type == DataType_Int32 && m_int32 > 0) ? std::size_t(m_int32) : 0;
+	}
+
 	// Serialization functions
 
 private:
-	static bool DeserializeInternal(BitReader& reader, LuaData& out_data);
-	static bool DeserializeHeader(BitReader& reader);
+	friend class LuaStreamDecoder;
+	friend class LuaDataView;
+
+	// Fill in the union for the type that is already set, the string types can end up small
+	void copyHashCache(const LuaData& other);
+	void assignString(std::string_view str, std::pmr::memory_resource* resource);
+	void assignString(StringType&& str);
+	void assignTable(TableType&& table);
+
+	struct TableHeader
+	{
+		std::uint32_t m_itemCount;
+		std::uint32_t m_itemOffset;
+		bool m_isArray;
+		// Only set in FormatVersion_2 and up
+		bool m_hasEntriesSize;
+		std::uint32_t m_entriesSize; // Size in bits
+	};
+
+	// Shared by all of the values of one blob
+	struct DecodeContext
+	{
+		std::pmr::memory_resource* m_resource;
+		// Table keys that are strings are interned when this is set
+		LuaAtomPool* m_atomPool;
+		FormatVersion m_version;
+
+		// Big tables are decoded in chunks on the pool when this is set
+		LuaThreadPool* m_threadPool = nullptr;
+		// Guards the atom pool while chunks are decoded
+		std::mutex* m_atomMutex = nullptr;
+
+		// Tables are decoded with DeserializeStack instead of recursion when this is set,
+		// the ones nested deeper than m_maxDepth fail
+		bool m_isIterative = false;
+		std::size_t m_maxDepth = 0;
+	};
 
-	static bool SerializeBody(BitWriter& writer, const LuaData& data);
+	// Table that DeserializeStack is inside of, holds LuaData so it's defined in LuaData.cpp
+	struct DecodeFrame;
+
+	// Table that ValidateBody is inside of
+	struct ValidateFrame
+	{
+		// Keys and values that are left
+		std::uint64_t m_pendingCount;
+		// Bit index the entries have to end at, if the table stores their size
+		std::size_t m_entriesEnd;
+	};
+
+	struct EncodeContext
+	{
+		FormatVersion m_version;
+		// Big tables are written in chunks on the pool when this is set
+		LuaThreadPool* m_threadPool = nullptr;
+
+		// Tables are written with SerializeStack instead of recursion when this is set,
+		// the ones nested deeper than m_maxDepth fail
+		bool m_isIterative = false;
+		std::size_t m_maxDepth = 0;
+	};
+
+	// Table that SerializeStack is inside of
+	struct EncodeFrame
+	{
+		const TableType* m_table;
+		// Iteration position of the next entry
+		std::size_t m_position;
+		std::size_t m_sizeIndex;
+		std::size_t m_entriesStart;
+		// Arrays are written without their keys
+		bool m_hasKeys;
+		// The key of the current entry of the hash part is written, its value is next
+		bool m_isKeyWritten;
+	};
+
+	// Tables with at least this many entries get the size of their entries from FormatVersion_2 on
+	static constexpr std::uint32_t EntriesSizeMinCount = 16;
+
+	// Tables with fewer entries are never split into chunks
+	static constexpr std::uint32_t ParallelMinCount = 1024;
+	static constexpr std::uint32_t ParallelMinChunkSize = 256;
+	// Extra chunks per thread, so threads that finish early can steal the rest
+	static constexpr std::uint32_t ParallelChunksPerThread = 4;
+
+	// Hash of the characters, folded to 32 bits so it fits into the cache
+	inline static std::uint32_t HashString(std::size_t str_hash)
+	{
+		return std::uint32_t(std::uint64_t(str_hash) ^ (std::uint64_t(str_hash) >> 32));
+	}
+
+	// Type tags, sizes and integers are the parts of the encoding that depend on the version
+	static constexpr std::size_t CompactTypeBits = 4;
+
+	inline static void WriteType(BitWriter& writer, DataType type, FormatVersion version)
+	{
+		if (version >= FormatVersion_3)
+			writer.writeValue(type & ((1 << LuaData::CompactTypeBits) - 1), LuaData::CompactTypeBits);
+		else
+			writer.writeObject<DataType>(type);
+	}
+
+	inline static bool ReadType(BitReader& reader, DataType& out_type, FormatVersion version)
+	{
+		if (version < FormatVersion_3)
+			return reader.readObject<DataType>(&out_type);
+
+		std::uint64_t v_type;
+		if (!reader.readValue(&v_type, LuaData::CompactTypeBits)) return false;
+
+		out_type = DataType(v_type);
+		return true;
+	}
+
+	inline static void WriteSize(BitWriter& writer, std::uint32_t size, FormatVersion version)
+	{
+		if (version >= FormatVersion_3)
+			writer.writeVarUInt(size);
+		else
+			writer.writeObject<std::uint32_t, true>(size);
+	}
+
+	inline static bool ReadSize(BitReader& reader, std::uint32_t& out_size, FormatVersion version)
+	{
+		if (version < FormatVersion_3)
+			return reader.readObject<std::uint32_t, true>(&out_size);
+
+		std::uint64_t v_size;
+		if (!reader.readVarUInt(&v_size) || v_size > std::numeric_limits<std::uint32_t>::max()) return false;
+
+		out_size = std::uint32_t(v_size);
+		return true;
+	}
+
+	template<typename T>
+	inline static void WriteInteger(BitWriter& writer, T value, FormatVersion version)
+	{
+		if (version >= FormatVersion_3)
+			writer.writeVarInt(value);
+		else
+			writer.writeObject<T, true>(value);
+	}
+
+	template<typename T>
+	inline static bool ReadInteger(BitReader& reader, T& out_value, FormatVersion version)
+	{
+		if (version < FormatVersion_3)
+			return reader.readObject<T, true>(&out_value);
+
+		std::int64_t v_value;
+		if (!reader.readVarInt(&v_value)) return false;
+		if (v_value < std::numeric_limits<T>::min() || v_value > std::numeric_limits<T>::max()) return false;
+
+		out_value = T(v_value);
+		return true;
+	}
+
+	static bool DeserializeInternal(BitReader& reader, LuaData& out_data, const DecodeContext& context, bool is_key = false);
+	// DeserializeInternal without recursion, the frames of the tables are kept on a stack on the heap
+	static bool DeserializeStack(BitReader& reader, LuaData& out_data, const DecodeContext& context);
+	static bool DeserializeStackEntries(BitReader& reader, LuaData& out_data, std::vector<DecodeFrame>& stack, const DecodeContext& context);
+	// Decompresses the blob first when a compressor is given and it isn't stored uncompressed
+	static bool DeserializeBlob(std::span<const std::byte> data, LuaData& out_data, const LuaCompressor* compressor,
+		DecodeContext& context);
+	// Reads a single value. Tables are returned empty, with their entries following in the stream
+	static bool DeserializeValue(BitReader& reader, LuaData& out_data, TableHeader& out_header, const DecodeContext& context, bool is_key);
+	static bool ReadTableHeader(BitReader& reader, TableHeader& out_header, FormatVersion version);
+	// Moves the reader past the next value, including all of the entries of tables, without decoding it
+	static bool SkipValue(BitReader& reader, FormatVersion version);
+	// Finds the chunks of the entries with SkipValue, decodes them on the pool and inserts them in order
+	static bool DeserializeEntriesParallel(BitReader& reader, TableType& table, const TableHeader& header, const DecodeContext& context);
+	static void InsertArrayItem(TableType& table, const TableHeader& header, std::uint32_t item_idx, LuaData&& value);
+	static bool DeserializeHeader(BitReader& reader, FormatVersion& out_version);
+	// Walks the values like DeserializeInternal without creating any of them
+	static bool ValidateBody(BitReader& reader, const ValidateLimits& limits, ValidateResult& out_result);
+
+	static bool SerializeBody(BitWriter& writer, const LuaData& data, const EncodeContext& context);
+	// SerializeBody without recursion, the frames of the tables are kept on a stack on the heap
+	static bool SerializeStack(BitWriter& writer, const LuaData& data, const EncodeContext& context);
+	// Writes a table up to its entries and pushes its frame
+	static bool PushEncodeFrame(BitWriter& writer, const TableType& table, std::vector<EncodeFrame>& stack, const EncodeContext& context);
+	// Writes everything of a table between its type and its entries. out_size_index is where the
+	// size of the entries goes once it's known, or 0 if the table doesn't store it
+	static void WriteTableHeader(BitWriter& writer, const TableType& table, FormatVersion version, std::size_t& out_size_index);
+	static bool PatchEntriesSize(BitWriter& writer, std::size_t size_index, std::size_t entries_start);
+	// Compresses the blob with the compressor when one is given
+	static bool SerializeBlob(const LuaData& data, std::vector<std::uint8_t>& out_data, LuaCompressor* compressor,
+		const CompressionOptions& options, const EncodeContext& context);
+	// Writes the entries [first, last) in the order of the table iterator
+	static bool SerializeEntries(BitWriter& writer, const TableType& table, std::size_t first, std::size_t last, const EncodeContext& context);
+	// Writes chunks of the entries into their own writers on the pool and appends them in order
+	static bool SerializeEntriesParallel(BitWriter& writer, const TableType& table, const EncodeContext& context);
+	static bool SerializeToWriter(BitWriter& writer, const LuaData& data, const EncodeContext& context);
+	// Appends the blobs to the batch, reusing one writer and one LZ4 stream for all of them
+	static bool SerializeBatchRange(std::span<const LuaData> data, LuaBlobBatch& out_batch, bool compress, FormatVersion version);
+	static bool HasEntriesSize(const TableType& table, bool is_array);
+
+	struct ScratchBuffers
+	{
+		std::vector<std::uint8_t> m_body;
+		std::vector<std::uint8_t> m_compressed;
+		std::vector<std::uint8_t> m_decompressed;
+		std::vector<ValidateFrame> m_validateStack;
+		std::vector<EncodeFrame> m_encodeStack;
+		// Empty between calls, so none of the values outlive their memory resource
+		std::vector<DecodeFrame> m_decodeStack;
+		// Without a dictionary, used by all of the functions that compress on their own
+		LuaCompressor m_compressor;
+	};
+
+	static ScratchBuffers& GetScratchBuffers();
+
+	// Blobs stored with CompressionCodec_None start with the secret. No LZ4 block of a blob can,
+	// a block that starts with an 'L' token carries the 'L' of the secret right after it
+	static bool IsUncompressed(std::span<const std::byte> data);
+	static bool Decompress(std::span<const std::byte> data, std::vector<std::uint8_t>& out_data, std::size_t& out_size);
 
 public:
-	static bool Deserialize(const std::string& b64_data, LuaData& out_data);
-	static bool Serialize(const LuaData& data, std::string& out_b64_data);
+	// Upper limit for the decompressed size of a single blob
+	static constexpr std::size_t MaxDecompressedSize = 0x10000000;
+	// Nesting limit of the iterative functions, the tree is still destroyed recursively
+	static constexpr std::size_t DefaultMaxDepth = 1024;
+
+	// The strings and tables of the decoded tree are allocated from the resource, see LuaDocument.
+	// String keys become atoms of the pool when one is given.
+	//
+	// With a thread pool the entries of big tables are decoded in chunks on its threads, so the
+	// resource has to be thread safe. The chunks are found by skipping the entries up front,
+	// which is much cheaper with blobs from FormatVersion_2 on
+	static bool Deserialize(const std::string& b64_data, LuaData& out_data,
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource(), LuaAtomPool* atom_pool = nullptr,
+		LuaThreadPool* thread_pool = nullptr);
+	// With a thread pool the entries of big tables are written in chunks on its threads. The
+	// output is exactly the same as without one
+	static bool Serialize(const LuaData& data, std::string& out_b64_data, FormatVersion version = FormatVersion_1,
+		LuaThreadPool* thread_pool = nullptr);
+
+	// Binary versions without the base64 layer. The output buffer is overwritten and its
+	// capacity is reused, so passing the same buffer every time avoids any allocations.
+	// Uncompressed blobs are the raw bit stream, which is read in place without copies.
+	// Compressed blobs can come from any of the codecs, including CompressionCodec_None
+	static bool Deserialize(std::span<const std::byte> data, LuaData& out_data, bool is_compressed = true,
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource(), LuaAtomPool* atom_pool = nullptr,
+		LuaThreadPool* thread_pool = nullptr);
+	static bool Serialize(const LuaData& data, std::vector<std::uint8_t>& out_data, bool compress = true,
+		FormatVersion version = FormatVersion_1, LuaThreadPool* thread_pool = nullptr);
+
+	// Compressed with the codec of the options, which the decompression finds out on its own
+	static bool Serialize(const LuaData& data, std::vector<std::uint8_t>& out_data, const CompressionOptions& options,
+		FormatVersion version = FormatVersion_1, LuaThreadPool* thread_pool = nullptr);
+
+	// Compressed with the dictionary of the compressor, if it has one. Blobs with a dictionary can
+	// only be decompressed with a compressor that has the same dictionary
+	static bool Serialize(const LuaData& data, std::vector<std::uint8_t>& out_data, LuaCompressor& compressor,
+		const CompressionOptions& options = CompressionOptions(), FormatVersion version = FormatVersion_1,
+		LuaThreadPool* thread_pool = nullptr);
+	static bool Deserialize(std::span<const std::byte> data, LuaData& out_data, const LuaCompressor& compressor,
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource(), LuaAtomPool* atom_pool = nullptr,
+		LuaThreadPool* thread_pool = nullptr);
+
+	// Deserialize and Serialize without recursion, so deep blobs can't overflow the stack of threads
+	// that only have small ones. Tables nested deeper than max_depth fail, the outermost table is at
+	// depth 1. The output is the same, but big tables aren't split between threads
+	static bool DeserializeIterative(std::span<const std::byte> data, LuaData& out_data, bool is_compressed = true,
+		std::size_t max_depth = LuaData::DefaultMaxDepth, std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+		LuaAtomPool* atom_pool = nullptr);
+	static bool SerializeIterative(const LuaData& data, std::vector<std::uint8_t>& out_data, bool compress = true,
+		FormatVersion version = FormatVersion_1, std::size_t max_depth = LuaData::DefaultMaxDepth);
+
+	// Checks that a blob from an untrusted source can be deserialized and stays within the limits,
+	// without decoding it. Nothing is allocated besides the buffer the blob is decompressed into,
+	// which is reused between calls. out_result is only complete when the blob is valid
+	static bool Validate(std::span<const std::byte> data, bool is_compressed, const ValidateLimits& limits,
+		ValidateResult& out_result);
+	static bool Validate(std::span<const std::byte> data, const LuaCompressor& compressor, const ValidateLimits& limits,
+		ValidateResult& out_result);
+
+	// Makes a dictionary for LuaCompressor out of typical objects, the most typical ones should come last
+	static void BuildDictionary(std::span<const LuaData> samples, std::vector<std::uint8_t>& out_dictionary,
+		FormatVersion version = FormatVersion_1);
+
+	// Batches are split into chunks of at least this many objects when they are spread over a thread pool
+	static constexpr std::size_t BatchMinChunkSize = 32;
+
+	// Serializes every object into its own blob, all of them back to back in the batch, which is
+	// overwritten. The setup is paid once per batch instead of once per object, which is what
+	// dominates for small objects. With a thread pool the objects are serialized in chunks on its
+	// threads, the blobs are the same either way
+	static bool SerializeBatch(std::span<const LuaData> data, LuaBlobBatch& out_batch, bool compress = true,
+		FormatVersion version = FormatVersion_1, LuaThreadPool* thread_pool = nullptr);
+	// Fills out_data with one object per blob. The resource has to be thread safe when a thread pool is given
+	static bool DeserializeBatch(std::span<const std::span<const std::byte>> blobs, std::vector<LuaData>& out_data, bool is_compressed = true,
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource(), LuaThreadPool* thread_pool = nullptr);
+	static bool DeserializeBatch(const LuaBlobBatch& batch, std::vector<LuaData>& out_data, bool is_compressed = true,
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource(), LuaThreadPool* thread_pool = nullptr);
+
+	// Uncompressed size of the blocks written by SerializeStream
+	static constexpr std::size_t StreamBlockSize = 0x10000;
+
+	// Writes the blob as a sequence of LZ4 blocks that can be decoded with LuaStreamDecoder while it's being received
+	static bool SerializeStream(const LuaData& data, std::vector<std::uint8_t>& out_data, FormatVersion version = FormatVersion_1,
+		LuaThreadPool* thread_pool = nullptr);
+
+	// Strings and Json values up to this size are stored inside of the value, without an allocation
+	static constexpr std::size_t SmallStringSize = 8;
 
 	DataType m_type;
 
+	// Live in the padding between the type and the union, so they don't take any space.
+	// getHash is const and can run on several threads for the same value, so the cache is
+	// atomic. The hash is stored before m_isHashCached is set with release ordering
+	mutable std::atomic<bool> m_isHashCached = false;
+	bool m_isSmallString = false;
+	std::uint8_t m_smallSize = 0;
+	mutable std::atomic<std::uint32_t> m_hashCache = 0;
+
+	// Strings longer than SmallStringSize and tables are allocated from their own memory resource,
+	// which keeps every value at 16 bytes
 	union {
-		std::string m_string;
+		StringType* m_string;
+		char m_smallString[SmallStringSize];
+		const LuaAtom* m_atom;
 		bool m_boolean;
 		float m_number;
-		TableType m_table;
+		TableType* m_table;
 		std::int32_t m_int32;
 		std::int16_t m_int16;
 		std::int8_t m_int8;
@@ -119,6 +556,8 @@ public:
 	};
 };
 
+static_assert(sizeof(LuaData) == 16);
+
 #pragma warning(pop)
 
 namespace std
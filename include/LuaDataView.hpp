@@ -0,0 +1,139 @@
+#pragma once
+
+#include "LuaData.hpp"
+
+#include <string_view>
+#include <span>
+#include <vector>
+
+// Read-only view of a value inside of an uncompressed blob, which decodes nothing up front.
+//
+// Scalars are read when the view is created, strings point straight into the blob and tables
+// only read their header. Looking up a key walks the entries of the table and skips the values
+// it passes, including whole subtrees, without allocating anything. Malformed data is therefore
+// only noticed in the parts of the blob that are actually read. Tables of FormatVersion_2 blobs
+// that store the size of their entries are skipped without reading them at all.
+//
+// The blob has to outlive every view into it. Use LuaViewIndex when many keys of one big table
+// are looked up.
+class LuaDataView
+{
+public:
+	LuaDataView();
+
+	// Reads the header of the blob, the view points to the root value
+	static bool Open(std::span<const std::byte> data, LuaDataView& out_view);
+	// Decompresses the blob into the buffer first, which has to outlive the view
+	static bool OpenCompressed(std::span<const std::byte> data, std::vector<std::uint8_t>& out_buffer, LuaDataView& out_view);
+
+	inline DataType getType() const { return m_type; }
+	inline bool isTable() const { return m_type == DataType_Table; }
+
+	// Each of these fails when the value has a different type
+	bool getBoolean(bool& out_value) const;
+	bool getNumber(float& out_value) const;
+	// Accepts DataType_Int32, DataType_Int16 and DataType_Int8
+	bool getInteger(std::int32_t& out_value) const;
+	// Accepts DataType_String and DataType_Json, the characters are the ones in the blob
+	bool getString(std::string_view& out_value) const;
+
+	// Number of entries of a table
+	inline std::uint32_t size() const { return this->isTable() ? m_header.m_itemCount : 0; }
+
+	// Keys are matched just like LuaData keys, so a string only matches DataType_String
+	// and an integer only matches DataType_Int32
+	bool find(std::string_view key, LuaDataView& out_value) const;
+	bool find(std::int32_t key, LuaDataView& out_value) const;
+
+	// Calls func(const LuaDataView& key, const LuaDataView& value) for every entry of a table until
+	// it returns false. The keys of arrays are made up by the view. Returns false on malformed data
+	template<typename TFunc>
+	bool forEach(TFunc&& func) const
+	{
+		if (!this->isTable())
+			return false;
+
+		BitReader v_reader = m_reader;
+		for (std::uint32_t a = 0; a < m_header.m_itemCount; a++)
+		{
+			LuaDataView v_key, v_value;
+			if (m_header.m_isArray)
+				v_key = LuaDataView::MakeArrayKey(m_header.m_itemOffset + a);
+			else if (!LuaDataView::ReadView(v_reader, m_version, v_key) || !LuaDataView::SkipEntries(v_reader, v_key))
+				return false;
+
+			if (!LuaDataView::ReadView(v_reader, m_version, v_value))
+				return false;
+
+			if (!func(static_cast<const LuaDataView&>(v_key), static_cast<const LuaDataView&>(v_value)))
+				return true;
+
+			// The entries of the value are only skipped once the caller moves on
+			if (!LuaDataView::SkipEntries(v_reader, v_value))
+				return false;
+		}
+
+		return true;
+	}
+
+	// Fully decodes the value
+	bool decode(LuaData& out_data, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+private:
+	friend class LuaViewIndex;
+
+	// Creates the view of the value at the reader and moves the reader past it. The reader
+	// stops in front of the entries of tables, which SkipEntries moves it past
+	static bool ReadView(BitReader& reader, FormatVersion version, LuaDataView& out_view);
+	static bool SkipEntries(BitReader& reader, const LuaDataView& view);
+	static LuaDataView MakeArrayKey(std::uint32_t key);
+
+	DataType m_type;
+
+	union {
+		bool m_boolean;
+		float m_number;
+		std::int32_t m_int32;
+		std::int16_t m_int16;
+		std::int8_t m_int8;
+	};
+
+	std::string_view m_string;
+
+	// Tables only, the reader points to the first entry
+	LuaData::TableHeader m_header;
+	BitReader m_reader;
+	// Position of the type of the value, used to decode tables
+	std::size_t m_valueIndex;
+	FormatVersion m_version;
+};
+
+// Lookup table over the entries of one table view. Building it walks the table once,
+// after that every lookup is a binary search over the hashes of the keys.
+class LuaViewIndex
+{
+public:
+	LuaViewIndex() = default;
+	~LuaViewIndex() = default;
+
+	// Only keys that are strings or 32 bit integers are indexed
+	bool build(const LuaDataView& table);
+
+	bool find(std::string_view key, LuaDataView& out_value) const;
+	bool find(std::int32_t key, LuaDataView& out_value) const;
+
+	inline std::size_t size() const { return m_entries.size(); }
+
+private:
+	struct Entry
+	{
+		std::size_t m_hash;
+		LuaDataView m_key;
+		LuaDataView m_value;
+	};
+
+	template<typename TMatch>
+	bool findEntry(std::size_t hash, TMatch&& match, LuaDataView& out_value) const;
+
+	std::vector<Entry> m_entries;
+};
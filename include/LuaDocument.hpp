@@ -0,0 +1,73 @@
+#pragma once
+
+#include "LuaData.hpp"
+#include "LuaThreadPool.hpp"
+
+#include <memory_resource>
+#include <memory>
+#include <span>
+
+// Decoded LuaData tree together with the memory it lives in.
+//
+// Every string and table of the tree is allocated from a monotonic arena owned by the document,
+// so decoding only touches the heap when the arena has to grow, and dropping the tree releases
+// a few large blocks instead of freeing every node. The tree isn't even walked on destruction
+// as long as it was only read through getRoot().
+//
+// String keys are interned into the atom pool of the document, which lives in the same arena.
+// Keys that repeat in every entry of a table are therefore only stored once, and comparing them
+// while building the tables mostly comes down to comparing pointers.
+//
+// Values moved out of the tree keep pointing into the arena, so they must not outlive the
+// document or its next clear(). Copies allocate from the default resource and turn atoms back
+// into strings, so they are always safe.
+//
+// Blobs decoded on a thread pool allocate through a lock in front of the arena.
+class LuaDocument
+{
+public:
+	// Size of the first arena block, which is kept for the next blob after clear()
+	static constexpr std::size_t DefaultInitialSize = 0x10000;
+
+	LuaDocument(std::size_t initial_size = LuaDocument::DefaultInitialSize);
+	LuaDocument(const LuaDocument&) = delete;
+	LuaDocument(LuaDocument&&) = delete;
+	~LuaDocument();
+
+	LuaDocument& operator=(const LuaDocument&) = delete;
+	LuaDocument& operator=(LuaDocument&&) = delete;
+
+	// Replaces the current tree with the decoded blob
+	bool deserialize(const std::string& b64_data, LuaThreadPool* thread_pool = nullptr);
+	bool deserialize(std::span<const std::byte> data, bool is_compressed = true, LuaThreadPool* thread_pool = nullptr);
+
+	// Drops the tree and rewinds the arena to its first block
+	void clear();
+
+	inline const LuaData& getRoot() const { return m_root; }
+	// The tree may hold values from other resources once it's modified, so it has to be
+	// destroyed node by node after this has been called
+	inline LuaData& getMutableRoot()
+	{
+		m_isModified = true;
+		return m_root;
+	}
+
+	// Resource for new values that are added to the tree
+	inline std::pmr::memory_resource* getResource() { return &m_arena; }
+	inline LuaAtomPool& getAtomPool() { return m_atomPool; }
+
+private:
+	std::pmr::memory_resource* getDecodeResource(LuaThreadPool* thread_pool);
+	void releaseTree();
+
+	std::unique_ptr<std::byte[]> m_initialBlock;
+	std::pmr::monotonic_buffer_resource m_arena;
+	// The atom pool always allocates through this, since it's shared by the threads of a parallel decode
+	LuaLockedResource m_lockedArena;
+	LuaAtomPool m_atomPool;
+
+	// Only destroyed by releaseTree, which skips the destructor when all of the memory is in the arena
+	union { LuaData m_root; };
+	bool m_isModified;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "LuaData.hpp"
+
+#include <memory_resource>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// How table keys that aren't strings are written, JSON objects only have string keys
+enum JsonKeyMode : std::uint8_t
+{
+	// Numbers and booleans are written as strings, e.g. [5] becomes "5". Other keys fail
+	JsonKeyMode_Stringify = 0,
+	// Entries with keys that aren't strings are left out
+	JsonKeyMode_Skip      = 1,
+	// Writing fails on the first key that isn't a string
+	JsonKeyMode_Fail      = 2
+};
+
+struct JsonWriteOptions
+{
+	JsonKeyMode m_keyMode = JsonKeyMode_Stringify;
+	// Tables with nothing but the keys 1..n are written as arrays. Empty tables are always {}
+	bool m_writeArrays = true;
+	// DataType_Json values are inserted as they are instead of being written as strings
+	bool m_embedJson = true;
+};
+
+struct JsonReadOptions
+{
+	// Object keys that are integers in the range of Int32, e.g. the ones written by
+	// JsonKeyMode_Stringify, become Int32 keys again
+	bool m_parseIntegerKeys = false;
+	// Documents that nest deeper fail to parse instead of exhausting the stack
+	std::size_t m_maxDepth = 512;
+};
+
+// Conversion between LuaData and JSON text.
+//
+// Objects become tables with string keys and arrays become tables with the keys 1..n. Integers
+// within the range of Int32 become DataType_Int32, every other number DataType_Number. Numbers
+// that can't be represented in JSON, like inf and nan, are written as null.
+//
+// Strings are scanned 16 bytes at a time with SSE2 for quotes, backslashes and control characters, so
+// both directions only fall back to handling single characters around escape sequences. Text
+// outside of escape sequences is copied as it is, without validating its UTF-8.
+class LuaJson
+{
+public:
+	// Appends the JSON text to out_json. On failure out_json holds whatever was written so far
+	static bool Write(const LuaData& data, std::string& out_json, const JsonWriteOptions& options = JsonWriteOptions());
+	// The whole input has to be one JSON value, surrounded by nothing but whitespace
+	static bool Read(std::string_view json, LuaData& out_data, const JsonReadOptions& options = JsonReadOptions(),
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+};
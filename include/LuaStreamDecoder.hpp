@@ -0,0 +1,73 @@
+#pragma once
+
+#include "LuaData.hpp"
+
+#include <span>
+
+enum StreamStatus : std::uint8_t
+{
+	StreamStatus_NeedMoreData = 0,
+	StreamStatus_Done         = 1,
+	StreamStatus_Error        = 2
+};
+
+// Resumable decoder for blobs that arrive in pieces, e.g. from a socket.
+// Every chunk is decoded as soon as it is fed, so decoding overlaps with receiving.
+//
+// Compressed streams are the output of LuaData::SerializeStream: a sequence of blocks, each
+// prefixed with its compressed size as a big endian std::uint32_t. The blocks are decompressed
+// with the previous 64 KB of output as the dictionary, just like the LZ4 streaming decoder.
+// Uncompressed streams are the raw bit stream, as written by LuaData::Serialize without compression.
+class LuaStreamDecoder
+{
+public:
+	LuaStreamDecoder(bool is_compressed = true);
+	~LuaStreamDecoder() = default;
+
+	// Feeds the next chunk of the stream. Chunks can be split at any byte
+	StreamStatus feed(std::span<const std::byte> chunk);
+	// Prepares the decoder for the next stream
+	void reset();
+
+	inline StreamStatus getStatus() const { return m_status; }
+	// Only valid once the status is StreamStatus_Done
+	inline LuaData& getResult() { return m_result; }
+
+private:
+	// LZ4 can reference up to 64 KB of previous output
+	static constexpr std::size_t HistorySize = 0x10000;
+	// Consumed data is only dropped in big steps, so the buffer isn't shifted for every chunk
+	static constexpr std::size_t CompactThreshold = 0x40000;
+
+	// Table that is still waiting for its entries
+	struct Frame
+	{
+		LuaData m_table;
+		LuaData m_key;
+		LuaData::TableHeader m_header;
+		std::size_t m_entriesStart;
+		std::uint32_t m_itemIdx;
+		bool m_hasKey;
+	};
+
+	bool decompressBlocks();
+	StreamStatus parse();
+	bool isTruncated();
+	// Checks the varints of a FormatVersion_3 value that failed to decode
+	bool isVarIntTruncated(DataType type);
+	void compactData();
+
+	std::vector<std::uint8_t> m_input;
+	std::size_t m_inputOffset;
+
+	std::vector<std::uint8_t> m_data;
+	BitReader m_reader;
+
+	std::vector<Frame> m_stack;
+	LuaData m_result;
+
+	StreamStatus m_status;
+	bool m_isCompressed;
+	bool m_headerRead;
+	FormatVersion m_version;
+};
@@ -0,0 +1,468 @@
+#pragma once
+
+#include <initializer_list>
+#include <type_traits>
+#include <functional>
+#include <memory_resource>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Table representation of LuaData, split into two parts just like the tables of Lua itself:
+//
+// The array part stores the values of the keys 1..n contiguously without any keys or hashes.
+// The hash part is a flat open addressing hash table. Its entries are stored contiguously in
+// insertion order, while a separate slot array maps hashes to entry indices with linear probing.
+// Each slot caches the hash of its key, so probing and rehashing only compare keys when the
+// cached hashes match.
+//
+// All three arrays allocate from the memory resource passed on construction, so the tables of a
+// LuaDocument live inside of its arena. Copies use the default resource, moves keep the resource.
+//
+// TValue has to provide getArrayIndex(), which returns the 1-based array index of a key or 0
+// when the key can't be stored in the array part, and has to be constructible from std::int32_t.
+template<typename TValue>
+class LuaTable
+{
+public:
+	using value_type = std::pair<TValue, TValue>;
+
+	// Iterates over the array part first and then over the hash part. The keys of the array
+	// part are materialized inside of the iterator, so they are only valid until it moves
+	template<bool t_const>
+	class Iterator
+	{
+	public:
+		using TableType = std::conditional_t<t_const, const LuaTable, LuaTable>;
+		using ValueType = std::conditional_t<t_const, const TValue, TValue>;
+		using reference = std::pair<const TValue&, ValueType&>;
+
+		struct ArrowProxy
+		{
+			reference m_ref;
+			inline reference* operator->() { return &m_ref; }
+		};
+
+		Iterator(TableType* table, std::size_t index)
+			: m_table(table), m_index(index), m_arrayKey() {}
+
+		inline reference operator*() const
+		{
+			const std::size_t v_array_sz = m_table->m_array.size();
+			if (m_index < v_array_sz)
+			{
+				m_arrayKey = TValue(std::int32_t(m_index + 1));
+				return { m_arrayKey, m_table->m_array[m_index] };
+			}
+
+			auto& v_entry = m_table->m_entries[m_index - v_array_sz];
+			return { v_entry.first, v_entry.second };
+		}
+
+		inline ArrowProxy operator->() const { return ArrowProxy{ **this }; }
+
+		inline Iterator& operator++()
+		{
+			m_index++;
+			return *this;
+		}
+
+		inline bool operator==(const Iterator& rhs) const { return m_index == rhs.m_index; }
+		inline bool operator!=(const Iterator& rhs) const { return m_index != rhs.m_index; }
+
+	private:
+		TableType* m_table;
+		std::size_t m_index;
+		mutable TValue m_arrayKey;
+	};
+
+	using iterator = Iterator<false>;
+	using const_iterator = Iterator<true>;
+
+	LuaTable() = default;
+	explicit LuaTable(std::pmr::memory_resource* resource)
+		: m_array(resource), m_entries(resource), m_slots(resource) {}
+
+	LuaTable(const LuaTable&) = default;
+	LuaTable(LuaTable&&) noexcept = default;
+	~LuaTable() = default;
+
+	LuaTable(std::initializer_list<value_type> init_list)
+	{
+		for (const value_type& v_pair : init_list)
+			this->emplace(v_pair.first, v_pair.second);
+	}
+
+	LuaTable& operator=(const LuaTable&) = default;
+	LuaTable& operator=(LuaTable&&) noexcept = default;
+
+	inline std::size_t size() const { return m_array.size() + m_entries.size(); }
+	inline bool empty() const { return m_array.empty() && m_entries.empty(); }
+
+	inline iterator begin() { return iterator(this, 0); }
+	inline iterator end() { return iterator(this, this->size()); }
+	inline const_iterator begin() const { return const_iterator(this, 0); }
+	inline const_iterator end() const { return const_iterator(this, this->size()); }
+
+	// Values of the keys 1..n
+	inline const std::pmr::vector<TValue>& getArrayPart() const { return m_array; }
+	// Every key that is not in the array part
+	inline const std::pmr::vector<value_type>& getHashPart() const { return m_entries; }
+
+	inline std::pmr::memory_resource* getResource() const { return m_array.get_allocator().resource(); }
+
+	void clear()
+	{
+		m_array.clear();
+		m_entries.clear();
+		m_slots.clear();
+	}
+
+	inline void reserveArray(std::size_t count)
+	{
+		m_array.reserve(count);
+	}
+
+	void reserve(std::size_t count)
+	{
+		m_entries.reserve(count);
+
+		const std::size_t v_slot_count = LuaTable::GetSlotCount(count);
+		if (v_slot_count > m_slots.size())
+			this->rehash(v_slot_count);
+	}
+
+	// Bytes allocated by reserve(count), or by reserveArray(count) for the array part
+	inline static std::size_t GetReservedSize(std::size_t count, bool is_array)
+	{
+		return is_array
+			? count * sizeof(TValue)
+			: count * sizeof(value_type) + LuaTable::GetSlotCount(count) * sizeof(Slot);
+	}
+
+	// Appends the value with the key size of the array part + 1. Only valid while that key
+	// is not in the table, which is always the case when the hash part is empty
+	void appendArray(TValue&& value)
+	{
+		m_array.push_back(std::move(value));
+
+		if (!m_entries.empty())
+			this->migrateToArray();
+	}
+
+	iterator find(const TValue& key)
+	{
+		return iterator(this, this->findPosition(key));
+	}
+
+	const_iterator find(const TValue& key) const
+	{
+		return const_iterator(this, this->findPosition(key));
+	}
+
+	TValue* findValue(const TValue& key)
+	{
+		return const_cast<TValue*>(static_cast<const LuaTable*>(this)->findValue(key));
+	}
+
+	const TValue* findValue(const TValue& key) const
+	{
+		const std::size_t v_arr_idx = key.getArrayIndex();
+		if (v_arr_idx != 0 && v_arr_idx <= m_array.size())
+			return &m_array[v_arr_idx - 1];
+
+		const std::size_t v_idx = this->findIndex(key, LuaTable::HashKey(key));
+		return v_idx == NoEntry ? nullptr : &m_entries[v_idx].second;
+	}
+
+	inline bool contains(const TValue& key) const
+	{
+		return this->findValue(key) != nullptr;
+	}
+
+	inline std::size_t count(const TValue& key) const
+	{
+		return this->contains(key) ? 1 : 0;
+	}
+
+	TValue& operator[](const TValue& key)
+	{
+		return this->getValueAt(this->emplaceValue(key, TValue()).first);
+	}
+
+	TValue& operator[](TValue&& key)
+	{
+		return this->getValueAt(this->emplaceValue(std::move(key), TValue()).first);
+	}
+
+	// Inserts the value if the key is not in the table yet, just like std::map::emplace
+	template<typename TKey, typename TVal>
+	std::pair<iterator, bool> emplace(TKey&& key, TVal&& value)
+	{
+		const std::pair<std::size_t, bool> v_result = this->emplaceValue(
+			std::forward<TKey>(key), std::forward<TVal>(value));
+
+		return { iterator(this, v_result.first), v_result.second };
+	}
+
+	// Removes the key from the table. Erasing from the middle of the array part moves
+	// all of the following values into the hash part
+	std::size_t erase(const TValue& key)
+	{
+		const std::size_t v_arr_idx = key.getArrayIndex();
+		if (v_arr_idx != 0 && v_arr_idx <= m_array.size())
+		{
+			for (std::size_t a = v_arr_idx; a < m_array.size(); a++)
+				this->emplaceHash(TValue(std::int32_t(a + 1)), std::move(m_array[a]));
+
+			m_array.resize(v_arr_idx - 1);
+			return 1;
+		}
+
+		if (m_slots.empty())
+			return 0;
+
+		const std::size_t v_slot_idx = this->findSlot(key, LuaTable::HashKey(key));
+		if (v_slot_idx == NoEntry)
+			return 0;
+
+		this->eraseSlot(v_slot_idx);
+		return 1;
+	}
+
+	bool operator==(const LuaTable& rhs) const
+	{
+		// The array part always holds the longest 1..n run of keys, so equal tables have equal array parts
+		if (m_array.size() != rhs.m_array.size() || m_entries.size() != rhs.m_entries.size())
+			return false;
+
+		for (std::size_t a = 0; a < m_array.size(); a++)
+			if (!(m_array[a] == rhs.m_array[a]))
+				return false;
+
+		for (const value_type& v_pair : m_entries)
+		{
+			const std::size_t v_idx = rhs.findIndex(v_pair.first, LuaTable::HashKey(v_pair.first));
+			if (v_idx == NoEntry || !(rhs.m_entries[v_idx].second == v_pair.second))
+				return false;
+		}
+
+		return true;
+	}
+
+private:
+	struct Slot
+	{
+		std::uint32_t m_entryIdx;
+		std::uint32_t m_hash;
+	};
+
+	static constexpr std::uint32_t EmptySlot = 0xFFFFFFFF;
+	static constexpr std::size_t NoEntry = std::size_t(-1);
+
+	// Spreads the bits of std::hash, which is the identity function for integers on some platforms
+	inline static std::uint32_t HashKey(const TValue& key)
+	{
+		const std::uint64_t v_hash = std::uint64_t(std::hash<TValue>{}(key));
+		return std::uint32_t((v_hash * 0x9E3779B97F4A7C15ull) >> 32);
+	}
+
+	// Keeps the load factor of the slot array at or below 3/4
+	inline static std::size_t GetSlotCount(std::size_t entry_count)
+	{
+		std::size_t v_slot_count = 8;
+		while (v_slot_count * 3 < entry_count * 4)
+			v_slot_count <<= 1;
+
+		return v_slot_count;
+	}
+
+	std::size_t findPosition(const TValue& key) const
+	{
+		const std::size_t v_arr_idx = key.getArrayIndex();
+		if (v_arr_idx != 0 && v_arr_idx <= m_array.size())
+			return v_arr_idx - 1;
+
+		const std::size_t v_idx = this->findIndex(key, LuaTable::HashKey(key));
+		return v_idx == NoEntry ? this->size() : m_array.size() + v_idx;
+	}
+
+	inline TValue& getValueAt(std::size_t position)
+	{
+		return (position < m_array.size())
+			? m_array[position]
+			: m_entries[position - m_array.size()].second;
+	}
+
+	// Returns the iteration position of the value with the key
+	template<typename TKey, typename TVal>
+	std::pair<std::size_t, bool> emplaceValue(TKey&& key, TVal&& value)
+	{
+		if constexpr (!std::is_same_v<std::decay_t<TKey>, TValue>)
+		{
+			return this->emplaceValue(TValue(std::forward<TKey>(key)), std::forward<TVal>(value));
+		}
+		else
+		{
+			const std::size_t v_arr_idx = key.getArrayIndex();
+			if (v_arr_idx != 0 && v_arr_idx <= m_array.size() + 1)
+			{
+				if (v_arr_idx <= m_array.size())
+					return { v_arr_idx - 1, false };
+
+				m_array.emplace_back(std::forward<TVal>(value));
+
+				if (!m_entries.empty())
+					this->migrateToArray();
+
+				return { v_arr_idx - 1, true };
+			}
+
+			const std::pair<std::size_t, bool> v_result = this->emplaceHash(
+				std::forward<TKey>(key), std::forward<TVal>(value));
+
+			return { m_array.size() + v_result.first, v_result.second };
+		}
+	}
+
+	// Returns the index of the entry with the key
+	template<typename TKey, typename TVal>
+	std::pair<std::size_t, bool> emplaceHash(TKey&& key, TVal&& value)
+	{
+		const std::uint32_t v_hash = LuaTable::HashKey(key);
+
+		const std::size_t v_existing_idx = this->findIndex(key, v_hash);
+		if (v_existing_idx != NoEntry)
+			return { v_existing_idx, false };
+
+		if (LuaTable::GetSlotCount(m_entries.size() + 1) > m_slots.size())
+			this->rehash(LuaTable::GetSlotCount((m_entries.size() + 1) * 2));
+
+		const std::size_t v_new_idx = m_entries.size();
+		m_entries.emplace_back(std::forward<TKey>(key), std::forward<TVal>(value));
+		this->insertSlot(std::uint32_t(v_new_idx), v_hash);
+
+		return { v_new_idx, true };
+	}
+
+	// Moves the keys that directly follow the array part out of the hash part
+	void migrateToArray()
+	{
+		while (!m_entries.empty())
+		{
+			const TValue v_next_key(std::int32_t(m_array.size() + 1));
+
+			const std::size_t v_slot_idx = this->findSlot(v_next_key, LuaTable::HashKey(v_next_key));
+			if (v_slot_idx == NoEntry)
+				break;
+
+			m_array.push_back(std::move(m_entries[m_slots[v_slot_idx].m_entryIdx].second));
+			this->eraseSlot(v_slot_idx);
+		}
+	}
+
+	std::size_t findSlot(const TValue& key, std::uint32_t hash) const
+	{
+		if (m_slots.empty())
+			return NoEntry;
+
+		const std::size_t v_mask = m_slots.size() - 1;
+		for (std::size_t a = hash & v_mask;; a = (a + 1) & v_mask)
+		{
+			const Slot& v_slot = m_slots[a];
+			if (v_slot.m_entryIdx == EmptySlot)
+				return NoEntry;
+
+			if (v_slot.m_hash == hash && m_entries[v_slot.m_entryIdx].first == key)
+				return a;
+		}
+	}
+
+	inline std::size_t findIndex(const TValue& key, std::uint32_t hash) const
+	{
+		const std::size_t v_slot_idx = this->findSlot(key, hash);
+		return v_slot_idx == NoEntry ? NoEntry : std::size_t(m_slots[v_slot_idx].m_entryIdx);
+	}
+
+	void insertSlot(std::uint32_t entry_idx, std::uint32_t hash)
+	{
+		const std::size_t v_mask = m_slots.size() - 1;
+
+		std::size_t v_slot_idx = hash & v_mask;
+		while (m_slots[v_slot_idx].m_entryIdx != EmptySlot)
+			v_slot_idx = (v_slot_idx + 1) & v_mask;
+
+		m_slots[v_slot_idx] = { entry_idx, hash };
+	}
+
+	// Removes the entry of the slot. The last entry is moved into the freed spot,
+	// so erasing changes the iteration order of that one entry
+	void eraseSlot(std::size_t slot_idx)
+	{
+		const std::size_t v_mask = m_slots.size() - 1;
+
+		const std::uint32_t v_entry_idx = m_slots[slot_idx].m_entryIdx;
+		this->removeSlot(slot_idx);
+
+		const std::uint32_t v_last_idx = std::uint32_t(m_entries.size() - 1);
+		if (v_entry_idx != v_last_idx)
+		{
+			// Point the slot of the last entry to its new location
+			const std::uint32_t v_last_hash = LuaTable::HashKey(m_entries[v_last_idx].first);
+			for (std::size_t a = v_last_hash & v_mask;; a = (a + 1) & v_mask)
+			{
+				if (m_slots[a].m_entryIdx == v_last_idx)
+				{
+					m_slots[a].m_entryIdx = v_entry_idx;
+					break;
+				}
+			}
+
+			m_entries[v_entry_idx] = std::move(m_entries[v_last_idx]);
+		}
+
+		m_entries.pop_back();
+	}
+
+	// Backward shift deletion, which keeps the probe sequences intact without tombstones
+	void removeSlot(std::size_t slot_idx)
+	{
+		const std::size_t v_mask = m_slots.size() - 1;
+
+		std::size_t v_hole = slot_idx;
+		for (std::size_t a = (v_hole + 1) & v_mask;; a = (a + 1) & v_mask)
+		{
+			const Slot& v_slot = m_slots[a];
+			if (v_slot.m_entryIdx == EmptySlot)
+				break;
+
+			const std::size_t v_home = v_slot.m_hash & v_mask;
+			const bool v_can_move = (v_hole <= a)
+				? (v_home <= v_hole || v_home > a)
+				: (v_home <= v_hole && v_home > a);
+
+			if (v_can_move)
+			{
+				m_slots[v_hole] = v_slot;
+				v_hole = a;
+			}
+		}
+
+		m_slots[v_hole].m_entryIdx = EmptySlot;
+	}
+
+	void rehash(std::size_t slot_count)
+	{
+		std::pmr::vector<Slot> v_old_slots(slot_count, Slot{ EmptySlot, 0 }, m_slots.get_allocator());
+		m_slots.swap(v_old_slots);
+
+		for (const Slot& v_slot : v_old_slots)
+			if (v_slot.m_entryIdx != EmptySlot)
+				this->insertSlot(v_slot.m_entryIdx, v_slot.m_hash);
+	}
+
+	std::pmr::vector<TValue> m_array;
+	std::pmr::vector<value_type> m_entries;
+	std::pmr::vector<Slot> m_slots;
+};
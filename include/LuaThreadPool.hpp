@@ -0,0 +1,106 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory_resource>
+#include <functional>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+
+// Work stealing thread pool. Every worker has its own queue, takes the newest task from it and
+// steals the oldest tasks of the other workers once it runs out. Threads that wait for a group
+// run the queued tasks of that group in the meantime, so tasks can start and wait for groups of
+// their own. Tasks of other groups are left alone, since they could use the same thread local
+// buffers as the task that waits.
+class LuaThreadPool
+{
+public:
+	// Tasks that are waited on together
+	class TaskGroup
+	{
+	public:
+		TaskGroup() : m_pending(0) {}
+		TaskGroup(const TaskGroup&) = delete;
+		~TaskGroup() = default;
+
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+	private:
+		friend class LuaThreadPool;
+
+		std::atomic<std::size_t> m_pending;
+	};
+
+	LuaThreadPool(std::size_t thread_count = std::thread::hardware_concurrency());
+	LuaThreadPool(const LuaThreadPool&) = delete;
+	~LuaThreadPool();
+
+	LuaThreadPool& operator=(const LuaThreadPool&) = delete;
+
+	void run(TaskGroup& group, std::function<void()> task);
+	// Runs tasks of the group until all of them are done
+	void wait(TaskGroup& group);
+
+	inline std::size_t getThreadCount() const { return m_threads.size(); }
+
+private:
+	struct Task
+	{
+		std::function<void()> m_func;
+		TaskGroup* m_group;
+	};
+
+	struct Worker
+	{
+		std::mutex m_mutex;
+		std::deque<Task> m_tasks;
+	};
+
+	// Index of the worker that runs on the calling thread, or the number of workers
+	std::size_t getCurrentWorker() const;
+	// Runs a task of the group, or of any group when it's null
+	bool runNextTask(std::size_t worker_idx, const TaskGroup* group);
+	void workerLoop(std::size_t worker_idx);
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::vector<std::thread> m_threads;
+
+	std::atomic<std::size_t> m_queuedCount;
+	std::atomic<std::size_t> m_nextQueue;
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_sleepCondition;
+	bool m_stop;
+};
+
+// Serializes all calls into a resource that isn't thread safe, e.g. the arena of a LuaDocument
+class LuaLockedResource : public std::pmr::memory_resource
+{
+public:
+	LuaLockedResource(std::pmr::memory_resource* upstream) : m_upstream(upstream) {}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override
+	{
+		std::lock_guard<std::mutex> v_lock(m_mutex);
+		return m_upstream->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+	{
+		std::lock_guard<std::mutex> v_lock(m_mutex);
+		m_upstream->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+	std::pmr::memory_resource* m_upstream;
+	std::mutex m_mutex;
+};
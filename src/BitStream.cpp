@@ -5,6 +5,12 @@ BitReader::BitReader(const void* data_ptr, std::size_t data_size)
 	m_dataSize(data_size * 8),
 	m_dataIndex(0) {}
 
+void BitReader::setData(const void* data_ptr, std::size_t data_size)
+{
+	m_dataPtr = reinterpret_cast<const std::uint8_t*>(data_ptr);
+	m_dataSize = data_size * 8;
+}
+
 bool BitReader::isEnoughData(std::size_t bit_count) const
 {
 	return (m_dataIndex + bit_count) <= m_dataSize;
@@ -32,41 +38,52 @@ bool BitReader::readBits(
 	if (bit_count <= 0 || !this->isEnoughData(bit_count))
 		return false;
 
-	const std::size_t v_aligned_offset = m_dataIndex & 7;
-	if (v_aligned_offset == 0 && (bit_count & 7) == 0)
+	std::uint8_t* pArrData = reinterpret_cast<std::uint8_t*>(data_ptr);
+	std::size_t v_byte_count = bit_count >> 3;
+
+	if ((m_dataIndex & 7) == 0)
 	{
-		std::memcpy(data_ptr, m_dataPtr + (m_dataIndex >> 3), bit_count >> 3);
-		m_dataIndex += bit_count;
-		return true;
+		std::memcpy(pArrData, m_dataPtr + (m_dataIndex >> 3), v_byte_count);
+		m_dataIndex += v_byte_count * 8;
+		pArrData += v_byte_count;
 	}
-
-	std::memset(data_ptr, 0, (bit_count + 7) >> 3);
-
-	const std::size_t v_neg_offset = 8 - v_aligned_offset;
-	std::uint8_t* pArrData = reinterpret_cast<std::uint8_t*>(data_ptr);
-	while (bit_count > 0)
+	else
 	{
-		const std::size_t v_read_byte = m_dataIndex >> 3;
+		// The size was checked above, but a read that fails anyway mustn't leave garbage behind
+		std::uint64_t v_value;
+		for (; v_byte_count >= 8; v_byte_count -= 8, pArrData += 8)
+		{
+			if (!this->readValue(&v_value, 64))
+				return false;
 
-		*pArrData |= m_dataPtr[v_read_byte] << v_aligned_offset;
-		if (bit_count > v_neg_offset)
-			*pArrData |= m_dataPtr[v_read_byte + 1] >> v_neg_offset;
+			if constexpr (std::endian::native == std::endian::little)
+				v_value = ByteSwap(v_value);
 
-		if (bit_count >= 8)
-		{
-			bit_count -= 8;
-			m_dataIndex += 8;
-			pArrData++;
-			continue;
+			std::memcpy(pArrData, &v_value, sizeof(v_value));
 		}
 
-		if (align_right)
-			*pArrData >>= (8 - bit_count);
+		for (; v_byte_count > 0; v_byte_count--)
+		{
+			if (!this->readValue(&v_value, 8))
+				return false;
 
-		m_dataIndex += bit_count;
-		break;
+			*(pArrData++) = std::uint8_t(v_value);
+		}
 	}
 
+	const std::size_t v_rest_bits = bit_count & 7;
+	if (v_rest_bits == 0)
+		return true;
+
+	// The remaining bits go either into the lowest or the highest bits of the last byte
+	std::uint64_t v_rest_value;
+	if (!this->readValue(&v_rest_value, v_rest_bits))
+		return false;
+
+	*pArrData = align_right
+		? std::uint8_t(v_rest_value)
+		: std::uint8_t(v_rest_value << (8 - v_rest_bits));
+
 	return true;
 }
 
@@ -83,7 +100,16 @@ void BitReader::alignIndex()
 
 BitWriter::BitWriter() :
 	m_dataIndex(0),
-	m_data() {}
+	m_data(),
+	m_alignCount(0),
+	m_cache(0),
+	m_cacheBits(0) {}
+
+BitWriter::BitWriter(std::size_t reserve_size) :
+	BitWriter()
+{
+	m_data.reserve(reserve_size);
+}
 
 void BitWriter::writeBits(
 	const void* data_ptr,
@@ -93,51 +119,120 @@ void BitWriter::writeBits(
 	if (bit_count == 0)
 		return;
 
-	const std::size_t v_new_byte_count = (m_dataIndex + bit_count + 7) >> 3;
-	m_data.resize(v_new_byte_count);
+	const std::uint8_t* v_cur_byte = reinterpret_cast<const std::uint8_t*>(data_ptr);
+	std::size_t v_byte_count = bit_count >> 3;
+
+	if ((m_dataIndex & 7) == 0 && v_byte_count >= 8)
+	{
+		// Aligned data is copied straight into the buffer
+		this->flush();
+
+		m_data.insert(m_data.end(), v_cur_byte, v_cur_byte + v_byte_count);
+		m_dataIndex += v_byte_count * 8;
 
-	const std::size_t v_aligned_idx = m_dataIndex & 7;
+		v_cur_byte += v_byte_count;
+		v_byte_count = 0;
+	}
 
-	if (v_aligned_idx == 0 && (bit_count & 7) == 0)
+	for (; v_byte_count >= 8; v_byte_count -= 8, v_cur_byte += 8)
 	{
-		std::memcpy(m_data.data() + (m_dataIndex >> 3), data_ptr, bit_count >> 3);
-		m_dataIndex += bit_count;
-		return;
+		std::uint64_t v_word;
+		std::memcpy(&v_word, v_cur_byte, sizeof(v_word));
+
+		if constexpr (std::endian::native == std::endian::little)
+			v_word = ByteSwap(v_word);
+
+		this->writeValue(v_word, 64);
 	}
 
+	for (; v_byte_count > 0; v_byte_count--)
+		this->writeValue(*(v_cur_byte++), 8);
 
-	const std::uint8_t* v_cur_byte = reinterpret_cast<const std::uint8_t*>(data_ptr);
-	std::uint8_t v_out_byte;
+	const std::size_t v_rest_bits = bit_count & 7;
+	if (v_rest_bits == 0)
+		return;
+
+	// The remaining bits are either the lowest or the highest bits of the last byte
+	const std::uint8_t v_last_byte = *v_cur_byte;
+	const std::uint64_t v_rest_value = align_right
+		? (v_last_byte & ((1u << v_rest_bits) - 1))
+		: (v_last_byte >> (8 - v_rest_bits));
+
+	this->writeValue(v_rest_value, v_rest_bits);
+}
+
+void BitWriter::appendBits(const void* data_ptr, std::size_t bit_offset, std::size_t bit_count)
+{
+	const std::uint8_t* v_cur_byte = reinterpret_cast<const std::uint8_t*>(data_ptr) + (bit_offset >> 3);
 
-	while (bit_count > 0)
+	// Bits up to the next byte boundary of the source, the rest is written from whole bytes
+	const std::size_t v_head_offset = bit_offset & 7;
+	if (v_head_offset != 0 && bit_count != 0)
 	{
-		v_out_byte = *(v_cur_byte++);
+		const std::size_t v_head_bits = std::min(8 - v_head_offset, bit_count);
+		const std::uint64_t v_head = (std::uint64_t(*v_cur_byte) >> (8 - v_head_offset - v_head_bits)) & ((1u << v_head_bits) - 1);
 
-		if (bit_count < 8 && align_right)
-			v_out_byte <<= (8 - bit_count);
+		this->writeValue(v_head, v_head_bits);
 
-		const std::size_t v_byte_idx = m_dataIndex >> 3;
-		if (v_aligned_idx == 0)
-		{
-			m_data[v_byte_idx] = v_out_byte;
-		}
-		else
-		{
-			m_data[v_byte_idx] |= v_out_byte >> v_aligned_idx;
+		v_cur_byte++;
+		bit_count -= v_head_bits;
+	}
 
-			const std::size_t v_neg_idx = 8 - v_aligned_idx;
-			if (v_neg_idx < 8 && v_neg_idx < bit_count)
-				m_data[v_byte_idx + 1] = v_out_byte << v_neg_idx;
-		}
+	this->writeBits(v_cur_byte, bit_count);
+}
 
-		if (bit_count >= 8)
-		{
-			m_dataIndex += 8;
-			bit_count -= 8;
-			continue;
-		}
+void BitWriter::flush()
+{
+	if (m_cacheBits == 0)
+		return;
+
+	const std::size_t v_byte_count = (m_cacheBits + 7) >> 3;
+	const std::uint64_t v_cache = ByteSwap(m_cache);
+
+	const std::uint8_t* v_bytes = reinterpret_cast<const std::uint8_t*>(&v_cache);
+	if constexpr (std::endian::native == std::endian::big)
+		v_bytes = reinterpret_cast<const std::uint8_t*>(&m_cache);
+
+	m_data.insert(m_data.end(), v_bytes, v_bytes + v_byte_count);
 
-		m_dataIndex += bit_count;
-		break;
+	m_cache = 0;
+	m_cacheBits = 0;
+}
+
+void BitWriter::patchValue(std::size_t bit_index, std::uint64_t value, std::size_t bit_count)
+{
+	// The bits might still be in the cache, the next write picks up the flushed partial byte again
+	this->flush();
+
+	for (std::size_t a = 0; a < bit_count; a++)
+	{
+		const std::size_t v_bit_idx = bit_index + a;
+		const std::uint8_t v_mask = std::uint8_t(0x80 >> (v_bit_idx & 7));
+
+		if ((value >> (bit_count - 1 - a)) & 1)
+			m_data[v_bit_idx >> 3] |= v_mask;
+		else
+			m_data[v_bit_idx >> 3] &= std::uint8_t(~v_mask);
 	}
-}
\ No newline at end of file
+}
+
+void BitWriter::flushCache()
+{
+	std::uint64_t v_word = m_cache;
+	if constexpr (std::endian::native == std::endian::little)
+		v_word = ByteSwap(v_word);
+
+	const std::uint8_t* v_bytes = reinterpret_cast<const std::uint8_t*>(&v_word);
+	m_data.insert(m_data.end(), v_bytes, v_bytes + sizeof(v_word));
+
+	m_cache = 0;
+	m_cacheBits = 0;
+}
+
+void BitWriter::reloadCache()
+{
+	// The last byte was flushed while it was only partially written
+	m_cache = std::uint64_t(m_data.back()) << 56;
+	m_cacheBits = m_dataIndex & 7;
+	m_data.pop_back();
+}
@@ -0,0 +1,93 @@
+#include "LuaAtom.hpp"
+
+#include <functional>
+#include <cstring>
+#include <new>
+
+LuaAtomPool::LuaAtomPool(std::pmr::memory_resource* resource)
+	: m_storage(resource),
+	m_slots(&m_storage),
+	m_count(0) {}
+
+const LuaAtom* LuaAtomPool::intern(std::string_view str)
+{
+	const std::size_t v_hash = std::hash<std::string_view>{}(str);
+
+	std::size_t v_slot_idx = this->findSlot(str, v_hash);
+	if (v_slot_idx != std::size_t(-1) && m_slots[v_slot_idx] != nullptr)
+		return m_slots[v_slot_idx];
+
+	// Keep the load factor at or below 1/2
+	if ((m_count + 1) * 2 > m_slots.size())
+	{
+		this->rehash(m_slots.empty() ? 64 : m_slots.size() * 2);
+		v_slot_idx = this->findSlot(str, v_hash);
+	}
+
+	// The characters are stored right behind the atom
+	void* v_memory = m_storage.allocate(sizeof(LuaAtom) + str.size(), alignof(LuaAtom));
+	char* v_chars = static_cast<char*>(v_memory) + sizeof(LuaAtom);
+	if (!str.empty())
+		std::memcpy(v_chars, str.data(), str.size());
+
+	const LuaAtom* v_atom = new (v_memory) LuaAtom{ std::string_view(v_chars, str.size()), v_hash };
+
+	m_slots[v_slot_idx] = v_atom;
+	m_count++;
+
+	return v_atom;
+}
+
+const LuaAtom* LuaAtomPool::find(std::string_view str) const
+{
+	const std::size_t v_slot_idx = this->findSlot(str, std::hash<std::string_view>{}(str));
+	return v_slot_idx == std::size_t(-1) ? nullptr : m_slots[v_slot_idx];
+}
+
+void LuaAtomPool::clear()
+{
+	m_slots = std::pmr::vector<const LuaAtom*>(&m_storage);
+	m_count = 0;
+
+	m_storage.release();
+}
+
+LuaAtomPool& LuaAtomPool::GetThreadPool()
+{
+	thread_local LuaAtomPool v_pool;
+	return v_pool;
+}
+
+// Returns the slot of the string or the empty slot where it belongs
+std::size_t LuaAtomPool::findSlot(std::string_view str, std::size_t hash) const
+{
+	if (m_slots.empty())
+		return std::size_t(-1);
+
+	const std::size_t v_mask = m_slots.size() - 1;
+	for (std::size_t a = hash & v_mask;; a = (a + 1) & v_mask)
+	{
+		const LuaAtom* v_atom = m_slots[a];
+		if (v_atom == nullptr || (v_atom->m_hash == hash && v_atom->m_string == str))
+			return a;
+	}
+}
+
+void LuaAtomPool::rehash(std::size_t slot_count)
+{
+	std::pmr::vector<const LuaAtom*> v_old_slots(slot_count, nullptr, &m_storage);
+	m_slots.swap(v_old_slots);
+
+	const std::size_t v_mask = m_slots.size() - 1;
+	for (const LuaAtom* v_atom : v_old_slots)
+	{
+		if (v_atom == nullptr)
+			continue;
+
+		std::size_t v_slot_idx = v_atom->m_hash & v_mask;
+		while (m_slots[v_slot_idx] != nullptr)
+			v_slot_idx = (v_slot_idx + 1) & v_mask;
+
+		m_slots[v_slot_idx] = v_atom;
+	}
+}
@@ -0,0 +1,443 @@
+#include "LuaBase64.hpp"
+
+#include <algorithm>
+#include <array>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LUA_BASE64_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define LUA_BASE64_X86 0
+#endif
+
+// MSVC allows any intrinsic anywhere, GCC and Clang only inside of functions built for the instruction set
+#if defined(_MSC_VER)
+#define LUA_TARGET(isa)
+#else
+#define LUA_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+static const char g_encodeTable[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+	"abcdefghijklmnopqrstuvwxyz"
+	"0123456789+/";
+
+static constexpr std::uint8_t InvalidChar = 0xFF;
+
+// Accepts both alphabets, just like pos_of_char of Dependencies/base64
+static constexpr std::array<std::uint8_t, 256> g_decodeTable = []()
+{
+	std::array<std::uint8_t, 256> v_table{};
+	v_table.fill(InvalidChar);
+
+	for (std::uint8_t a = 0; a < 64; a++)
+		v_table[std::uint8_t(g_encodeTable[a])] = a;
+
+	v_table['-'] = 62;
+	v_table['_'] = 63;
+	return v_table;
+}();
+
+static inline bool IsPadding(char chr)
+{
+	return chr == '=' || chr == '.';
+}
+
+static void EncodeScalar(const std::uint8_t* data, std::size_t size, char* out_data)
+{
+	std::size_t a = 0;
+	for (; a + 3 <= size; a += 3)
+	{
+		const std::uint32_t v_group = (std::uint32_t(data[a]) << 16) | (std::uint32_t(data[a + 1]) << 8) | data[a + 2];
+
+		*out_data++ = g_encodeTable[v_group >> 18];
+		*out_data++ = g_encodeTable[(v_group >> 12) & 0x3F];
+		*out_data++ = g_encodeTable[(v_group >> 6) & 0x3F];
+		*out_data++ = g_encodeTable[v_group & 0x3F];
+	}
+
+	const std::size_t v_left = size - a;
+	if (v_left == 0)
+		return;
+
+	std::uint32_t v_group = std::uint32_t(data[a]) << 16;
+	if (v_left == 2)
+		v_group |= std::uint32_t(data[a + 1]) << 8;
+
+	*out_data++ = g_encodeTable[v_group >> 18];
+	*out_data++ = g_encodeTable[(v_group >> 12) & 0x3F];
+	*out_data++ = (v_left == 2) ? g_encodeTable[(v_group >> 6) & 0x3F] : '=';
+	*out_data++ = '=';
+}
+
+// Decodes all of the characters, which don't contain any padding
+static bool DecodeScalar(const char* data, std::size_t size, std::uint8_t* out_data)
+{
+	std::size_t a = 0;
+	for (; a + 4 <= size; a += 4)
+	{
+		const std::uint32_t v_c0 = g_decodeTable[std::uint8_t(data[a])];
+		const std::uint32_t v_c1 = g_decodeTable[std::uint8_t(data[a + 1])];
+		const std::uint32_t v_c2 = g_decodeTable[std::uint8_t(data[a + 2])];
+		const std::uint32_t v_c3 = g_decodeTable[std::uint8_t(data[a + 3])];
+
+		if ((v_c0 | v_c1 | v_c2 | v_c3) == InvalidChar)
+			return false;
+
+		const std::uint32_t v_group = (v_c0 << 18) | (v_c1 << 12) | (v_c2 << 6) | v_c3;
+		*out_data++ = std::uint8_t(v_group >> 16);
+		*out_data++ = std::uint8_t(v_group >> 8);
+		*out_data++ = std::uint8_t(v_group);
+	}
+
+	const std::size_t v_left = size - a;
+	if (v_left == 0)
+		return true;
+
+	if (v_left == 1)
+		return false;
+
+	const std::uint32_t v_c0 = g_decodeTable[std::uint8_t(data[a])];
+	const std::uint32_t v_c1 = g_decodeTable[std::uint8_t(data[a + 1])];
+	const std::uint32_t v_c2 = (v_left == 3) ? g_decodeTable[std::uint8_t(data[a + 2])] : 0;
+
+	if ((v_c0 | v_c1 | v_c2) == InvalidChar)
+		return false;
+
+	const std::uint32_t v_group = (v_c0 << 18) | (v_c1 << 12) | (v_c2 << 6);
+	*out_data++ = std::uint8_t(v_group >> 16);
+	if (v_left == 3)
+		*out_data++ = std::uint8_t(v_group >> 8);
+
+	return true;
+}
+
+#if LUA_BASE64_X86
+
+// Splits 12 bytes into 16 indices of 6 bits each, one per byte. Every 32 bit lane gets the bytes
+// b, a, c, b of its group, so both pairs of indices can be moved into place with one multiply
+LUA_TARGET("ssse3") static inline __m128i SplitSSSE3(__m128i data)
+{
+	data = _mm_shuffle_epi8(data, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+	const __m128i v_idx_0_2 = _mm_mulhi_epu16(_mm_and_si128(data, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+	const __m128i v_idx_1_3 = _mm_mullo_epi16(_mm_and_si128(data, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+
+	return _mm_or_si128(v_idx_0_2, v_idx_1_3);
+}
+
+// Maps every range of indices to the offset of its first character and adds it
+LUA_TARGET("ssse3") static inline __m128i TranslateSSSE3(__m128i indices)
+{
+	const __m128i v_offsets = _mm_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+	// 0 for a-z, 1 to 10 for 0-9, 11 for '+', 12 for '/' and 13 for A-Z
+	__m128i v_range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+	v_range = _mm_or_si128(v_range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+
+	return _mm_add_epi8(indices, _mm_shuffle_epi8(v_offsets, v_range));
+}
+
+LUA_TARGET("ssse3") static std::size_t EncodeSSSE3(const std::uint8_t* data, std::size_t size, char* out_data)
+{
+	// Every step loads 16 bytes and uses 12 of them
+	std::size_t a = 0;
+	for (; a + 16 <= size; a += 12, out_data += 16)
+	{
+		const __m128i v_data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + a));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out_data), TranslateSSSE3(SplitSSSE3(v_data)));
+	}
+
+	return a;
+}
+
+// Characters above 0x7F are negative and never in range
+LUA_TARGET("ssse3") static inline __m128i InRangeSSSE3(__m128i chars, char first, char last)
+{
+	return _mm_and_si128(
+		_mm_cmpgt_epi8(chars, _mm_set1_epi8(char(first - 1))),
+		_mm_cmpgt_epi8(_mm_set1_epi8(char(last + 1)), chars));
+}
+
+// Turns characters into their indices, fails if any of them isn't part of either alphabet
+LUA_TARGET("ssse3") static inline bool LookupSSSE3(__m128i chars, __m128i& out_indices)
+{
+	const __m128i v_upper = InRangeSSSE3(chars, 'A', 'Z');
+	const __m128i v_lower = InRangeSSSE3(chars, 'a', 'z');
+	const __m128i v_digit = InRangeSSSE3(chars, '0', '9');
+	const __m128i v_plus = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('+')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('-')));
+	const __m128i v_slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+	const __m128i v_underscore = _mm_cmpeq_epi8(chars, _mm_set1_epi8('_'));
+
+	const __m128i v_valid = _mm_or_si128(_mm_or_si128(v_upper, v_lower), _mm_or_si128(_mm_or_si128(v_digit, v_plus), _mm_or_si128(v_slash, v_underscore)));
+	if (_mm_movemask_epi8(v_valid) != 0xFFFF)
+		return false;
+
+	// '+' and '-' are 2 apart, so the offset of '-' is corrected by subtracting their mask (-1) twice
+	__m128i v_offset = _mm_and_si128(v_upper, _mm_set1_epi8(-'A'));
+	v_offset = _mm_or_si128(v_offset, _mm_and_si128(v_lower, _mm_set1_epi8(26 - 'a')));
+	v_offset = _mm_or_si128(v_offset, _mm_and_si128(v_digit, _mm_set1_epi8(52 - '0')));
+	v_offset = _mm_or_si128(v_offset, _mm_and_si128(v_plus, _mm_set1_epi8(62 - '+')));
+	v_offset = _mm_or_si128(v_offset, _mm_and_si128(v_slash, _mm_set1_epi8(63 - '/')));
+	v_offset = _mm_or_si128(v_offset, _mm_and_si128(v_underscore, _mm_set1_epi8(63 - '_')));
+
+	const __m128i v_minus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('-'));
+	v_offset = _mm_add_epi8(v_offset, _mm_add_epi8(v_minus, v_minus));
+
+	out_indices = _mm_add_epi8(chars, v_offset);
+	return true;
+}
+
+// Packs the 6 bit indices back into 3 bytes per lane, which end up in the lowest 12 bytes
+LUA_TARGET("ssse3") static inline __m128i PackSSSE3(__m128i indices)
+{
+	const __m128i v_pairs = _mm_maddubs_epi16(indices, _mm_set1_epi32(0x01400140));
+	const __m128i v_groups = _mm_madd_epi16(v_pairs, _mm_set1_epi32(0x00011000));
+
+	return _mm_shuffle_epi8(v_groups, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+LUA_TARGET("ssse3") static std::size_t DecodeSSSE3(const char* data, std::size_t size, std::uint8_t* out_data)
+{
+	// Every step stores 16 bytes, 4 more than it decodes, which the output of the remaining 8 characters has room for.
+	// A block with an invalid character is left to the scalar decoder, which reports it
+	std::size_t a = 0;
+	for (; a + 24 <= size; a += 16, out_data += 12)
+	{
+		__m128i v_indices;
+		if (!LookupSSSE3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + a)), v_indices))
+			break;
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out_data), PackSSSE3(v_indices));
+	}
+
+	return a;
+}
+
+// The AVX2 versions do the same as the SSSE3 ones in both 128 bit lanes
+
+LUA_TARGET("avx2") static std::size_t EncodeAVX2(const std::uint8_t* data, std::size_t size, char* out_data)
+{
+	const __m256i v_shuffle = _mm256_broadcastsi128_si256(_mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	const __m256i v_offsets = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0));
+
+	// Every lane loads 16 bytes and uses 12 of them
+	std::size_t a = 0;
+	for (; a + 28 <= size; a += 24, out_data += 32)
+	{
+		__m256i v_data = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + a))),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + a + 12)), 1);
+
+		v_data = _mm256_shuffle_epi8(v_data, v_shuffle);
+
+		const __m256i v_idx_0_2 = _mm256_mulhi_epu16(_mm256_and_si256(v_data, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+		const __m256i v_idx_1_3 = _mm256_mullo_epi16(_mm256_and_si256(v_data, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+		const __m256i v_indices = _mm256_or_si256(v_idx_0_2, v_idx_1_3);
+
+		__m256i v_range = _mm256_subs_epu8(v_indices, _mm256_set1_epi8(51));
+		v_range = _mm256_or_si256(v_range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), v_indices), _mm256_set1_epi8(13)));
+
+		const __m256i v_chars = _mm256_add_epi8(v_indices, _mm256_shuffle_epi8(v_offsets, v_range));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out_data), v_chars);
+	}
+
+	return a;
+}
+
+LUA_TARGET("avx2") static inline __m256i InRangeAVX2(__m256i chars, char first, char last)
+{
+	return _mm256_and_si256(
+		_mm256_cmpgt_epi8(chars, _mm256_set1_epi8(char(first - 1))),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8(char(last + 1)), chars));
+}
+
+LUA_TARGET("avx2") static std::size_t DecodeAVX2(const char* data, std::size_t size, std::uint8_t* out_data)
+{
+	const __m256i v_pack = _mm256_broadcastsi128_si256(_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+	// Every step stores 32 bytes, 8 more than it decodes, which the output of the remaining 12 characters has room for
+	std::size_t a = 0;
+	for (; a + 44 <= size; a += 32, out_data += 24)
+	{
+		const __m256i v_chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + a));
+
+		const __m256i v_upper = InRangeAVX2(v_chars, 'A', 'Z');
+		const __m256i v_lower = InRangeAVX2(v_chars, 'a', 'z');
+		const __m256i v_digit = InRangeAVX2(v_chars, '0', '9');
+		const __m256i v_minus = _mm256_cmpeq_epi8(v_chars, _mm256_set1_epi8('-'));
+		const __m256i v_plus = _mm256_or_si256(_mm256_cmpeq_epi8(v_chars, _mm256_set1_epi8('+')), v_minus);
+		const __m256i v_slash = _mm256_cmpeq_epi8(v_chars, _mm256_set1_epi8('/'));
+		const __m256i v_underscore = _mm256_cmpeq_epi8(v_chars, _mm256_set1_epi8('_'));
+
+		const __m256i v_valid = _mm256_or_si256(_mm256_or_si256(v_upper, v_lower),
+			_mm256_or_si256(_mm256_or_si256(v_digit, v_plus), _mm256_or_si256(v_slash, v_underscore)));
+		if (_mm256_movemask_epi8(v_valid) != -1)
+			break;
+
+		__m256i v_offset = _mm256_and_si256(v_upper, _mm256_set1_epi8(-'A'));
+		v_offset = _mm256_or_si256(v_offset, _mm256_and_si256(v_lower, _mm256_set1_epi8(26 - 'a')));
+		v_offset = _mm256_or_si256(v_offset, _mm256_and_si256(v_digit, _mm256_set1_epi8(52 - '0')));
+		v_offset = _mm256_or_si256(v_offset, _mm256_and_si256(v_plus, _mm256_set1_epi8(62 - '+')));
+		v_offset = _mm256_or_si256(v_offset, _mm256_and_si256(v_slash, _mm256_set1_epi8(63 - '/')));
+		v_offset = _mm256_or_si256(v_offset, _mm256_and_si256(v_underscore, _mm256_set1_epi8(63 - '_')));
+		v_offset = _mm256_add_epi8(v_offset, _mm256_add_epi8(v_minus, v_minus));
+
+		const __m256i v_indices = _mm256_add_epi8(v_chars, v_offset);
+
+		const __m256i v_pairs = _mm256_maddubs_epi16(v_indices, _mm256_set1_epi32(0x01400140));
+		const __m256i v_groups = _mm256_shuffle_epi8(_mm256_madd_epi16(v_pairs, _mm256_set1_epi32(0x00011000)), v_pack);
+
+		// Moves the 12 bytes of the upper lane right behind the ones of the lower lane
+		const __m256i v_bytes = _mm256_permutevar8x32_epi32(v_groups, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out_data), v_bytes);
+	}
+
+	return a;
+}
+
+#endif
+
+static LuaBase64::Kernel DetectKernel()
+{
+#if LUA_BASE64_X86
+#if defined(_MSC_VER)
+	int v_info[4];
+	__cpuid(v_info, 0);
+	const int v_max_leaf = v_info[0];
+
+	__cpuid(v_info, 1);
+	const bool v_has_ssse3 = (v_info[2] & (1 << 9)) != 0;
+	// AVX needs the OS to save the YMM registers as well
+	const bool v_has_avx = (v_info[2] & (1 << 27)) != 0 && (v_info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+
+	bool v_has_avx2 = false;
+	if (v_has_avx && v_max_leaf >= 7)
+	{
+		__cpuidex(v_info, 7, 0);
+		v_has_avx2 = (v_info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	const bool v_has_ssse3 = __builtin_cpu_supports("ssse3");
+	const bool v_has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	if (v_has_avx2)
+		return LuaBase64::Kernel_AVX2;
+
+	if (v_has_ssse3)
+		return LuaBase64::Kernel_SSSE3;
+#endif
+
+	return LuaBase64::Kernel_Scalar;
+}
+
+LuaBase64::Kernel LuaBase64::GetKernel()
+{
+	static const Kernel v_kernel = DetectKernel();
+	return v_kernel;
+}
+
+void LuaBase64::Encode(std::span<const std::uint8_t> data, char* out_data, Kernel kernel)
+{
+	kernel = std::min(kernel, LuaBase64::GetKernel());
+
+	const std::uint8_t* v_data = data.data();
+	std::size_t v_size = data.size();
+
+#if LUA_BASE64_X86
+	// Every kernel leaves the tail that's too short for it to the next one
+	std::size_t v_done = 0;
+	if (kernel >= Kernel_AVX2)
+	{
+		v_done = EncodeAVX2(v_data, v_size, out_data);
+		v_data += v_done;
+		v_size -= v_done;
+		out_data += v_done / 3 * 4;
+	}
+
+	if (kernel >= Kernel_SSSE3)
+	{
+		v_done = EncodeSSSE3(v_data, v_size, out_data);
+		v_data += v_done;
+		v_size -= v_done;
+		out_data += v_done / 3 * 4;
+	}
+#endif
+
+	EncodeScalar(v_data, v_size, out_data);
+}
+
+bool LuaBase64::Decode(std::string_view data, std::uint8_t* out_data, std::size_t& out_size, Kernel kernel)
+{
+	kernel = std::min(kernel, LuaBase64::GetKernel());
+
+	// Up to 2 padding characters, which can only complete a group of 2 or 3 characters
+	std::size_t v_size = data.size();
+	std::size_t v_padding = 0;
+	while (v_padding < 2 && v_size > 0 && IsPadding(data[v_size - 1]))
+	{
+		v_size--;
+		v_padding++;
+	}
+
+	if (v_padding > 0 && ((v_size % 4) < 2 || (v_size % 4) + v_padding > 4))
+		return false;
+
+	const char* v_data = data.data();
+	std::uint8_t* v_out = out_data;
+
+#if LUA_BASE64_X86
+	std::size_t v_done = 0;
+	if (kernel >= Kernel_AVX2)
+	{
+		v_done = DecodeAVX2(v_data, v_size, v_out);
+		v_data += v_done;
+		v_size -= v_done;
+		v_out += v_done / 4 * 3;
+	}
+
+	if (kernel >= Kernel_SSSE3)
+	{
+		v_done = DecodeSSSE3(v_data, v_size, v_out);
+		v_data += v_done;
+		v_size -= v_done;
+		v_out += v_done / 4 * 3;
+	}
+#endif
+
+	if (!DecodeScalar(v_data, v_size, v_out))
+		return false;
+
+	out_size = std::size_t(v_out - out_data) + (v_size / 4) * 3 + ((v_size % 4 == 0) ? 0 : (v_size % 4) - 1);
+	return true;
+}
+
+void LuaBase64::Encode(std::span<const std::uint8_t> data, std::string& out_data)
+{
+	out_data.resize(LuaBase64::GetEncodedSize(data.size()));
+	LuaBase64::Encode(data, out_data.data());
+}
+
+bool LuaBase64::Decode(std::string_view data, std::vector<std::uint8_t>& out_data)
+{
+	out_data.resize(LuaBase64::GetMaxDecodedSize(data.size()));
+
+	std::size_t v_size;
+	if (!LuaBase64::Decode(data, out_data.data(), v_size))
+	{
+		out_data.clear();
+		return false;
+	}
+
+	out_data.resize(v_size);
+	return true;
+}
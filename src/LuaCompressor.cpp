@@ -0,0 +1,259 @@
+#include "LuaCompressor.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <lz4/lz4.h>
+
+// lz4hc.h isn't part of Dependencies, but the HC functions are in the same library
+#define LZ4HC_CLEVEL_DEFAULT 9
+
+extern "C"
+{
+	typedef union LZ4_streamHC_u LZ4_streamHC_t;
+
+	LZ4_streamHC_t* LZ4_createStreamHC(void);
+	int LZ4_freeStreamHC(LZ4_streamHC_t* streamHCPtr);
+	void LZ4_resetStreamHC_fast(LZ4_streamHC_t* streamHCPtr, int compressionLevel);
+	int LZ4_loadDictHC(LZ4_streamHC_t* streamHCPtr, const char* dictionary, int dictSize);
+	int LZ4_compress_HC_continue(LZ4_streamHC_t* streamHCPtr, const char* src, char* dst, int srcSize, int maxDstSize);
+	int LZ4_compress_HC_extStateHC(void* stateHC, const char* src, char* dst, int srcSize, int maxDstSize, int compressionLevel);
+}
+
+LuaCompressor::LuaCompressor()
+	: m_dictionary(),
+	m_stream(LZ4_createStream(), LZ4_freeStream),
+	m_dictStream(nullptr, LZ4_freeStream),
+	m_streamHC(nullptr, LZ4_freeStreamHC) {}
+
+LuaCompressor::LuaCompressor(std::span<const std::byte> dictionary)
+	: LuaCompressor()
+{
+	this->setDictionary(dictionary);
+}
+
+void LuaCompressor::setDictionary(std::span<const std::byte> dictionary)
+{
+	if (dictionary.size() > LuaCompressor::MaxDictionarySize)
+		dictionary = dictionary.last(LuaCompressor::MaxDictionarySize);
+
+	const std::uint8_t* v_dict_bytes = reinterpret_cast<const std::uint8_t*>(dictionary.data());
+	m_dictionary.assign(v_dict_bytes, v_dict_bytes + dictionary.size());
+
+	if (m_dictionary.empty())
+	{
+		m_dictStream.reset();
+		return;
+	}
+
+	if (!m_dictStream)
+		m_dictStream.reset(LZ4_createStream());
+
+	// The stream references the dictionary, which stays where it is until the next call
+	if (m_dictStream)
+		LZ4_loadDict(m_dictStream.get(), reinterpret_cast<const char*>(m_dictionary.data()), int(m_dictionary.size()));
+}
+
+bool LuaCompressor::compress(std::span<const std::uint8_t> data, std::vector<std::uint8_t>& out_data, const CompressionOptions& options)
+{
+	if (data.size() > std::size_t(LZ4_MAX_INPUT_SIZE))
+		return false;
+
+	switch (options.m_codec)
+	{
+	case CompressionCodec_None:
+		out_data.insert(out_data.end(), data.begin(), data.end());
+		return true;
+	case CompressionCodec_LZ4:
+		break;
+	case CompressionCodec_LZ4HC:
+		return this->compressHC(data, out_data, (options.m_level > 0) ? options.m_level : LZ4HC_CLEVEL_DEFAULT);
+	case CompressionCodec_Auto:
+		if (data.size() < options.m_minSize)
+		{
+			out_data.insert(out_data.end(), data.begin(), data.end());
+			return true;
+		}
+
+		break;
+	default:
+		return false;
+	}
+
+	if (!m_stream)
+		return false;
+
+	if (!m_dictionary.empty() && !m_dictStream)
+		return false;
+
+	// Copying the loaded state is a lot cheaper than loading the dictionary again, and a fast
+	// reset drops the history of the previous blob, so every blob is an independent block
+	if (m_dictStream)
+		std::memcpy(m_stream.get(), m_dictStream.get(), sizeof(LZ4_stream_t));
+	else
+		LZ4_resetStream_fast(m_stream.get());
+
+	const int v_data_sz = int(data.size());
+	const std::size_t v_offset = out_data.size();
+	out_data.resize(v_offset + std::size_t(LZ4_compressBound(v_data_sz)));
+
+	const int v_compressed_sz = LZ4_compress_fast_continue(
+		m_stream.get(),
+		reinterpret_cast<const char*>(data.data()),
+		reinterpret_cast<char*>(out_data.data() + v_offset),
+		v_data_sz,
+		int(out_data.size() - v_offset),
+		(options.m_level > 0) ? options.m_level : 1);
+
+	if (v_compressed_sz <= 0)
+	{
+		out_data.resize(v_offset);
+		return false;
+	}
+
+	out_data.resize(v_offset + std::size_t(v_compressed_sz));
+	return true;
+}
+
+bool LuaCompressor::compressHC(std::span<const std::uint8_t> data, std::vector<std::uint8_t>& out_data, int level)
+{
+	if (!m_streamHC)
+		m_streamHC.reset(LZ4_createStreamHC());
+
+	if (!m_streamHC)
+		return false;
+
+	const int v_data_sz = int(data.size());
+	const std::size_t v_offset = out_data.size();
+	out_data.resize(v_offset + std::size_t(LZ4_compressBound(v_data_sz)));
+
+	const char* v_src = reinterpret_cast<const char*>(data.data());
+	char* v_dst = reinterpret_cast<char*>(out_data.data() + v_offset);
+	const int v_dst_sz = int(out_data.size() - v_offset);
+
+	// The HC state is too big to keep a copy with the dictionary loaded, so it's loaded again,
+	// which is cheap compared to the compression itself
+	int v_compressed_sz;
+	if (m_dictionary.empty())
+	{
+		v_compressed_sz = LZ4_compress_HC_extStateHC(m_streamHC.get(), v_src, v_dst, v_data_sz, v_dst_sz, level);
+	}
+	else
+	{
+		LZ4_resetStreamHC_fast(m_streamHC.get(), level);
+		LZ4_loadDictHC(m_streamHC.get(), reinterpret_cast<const char*>(m_dictionary.data()), int(m_dictionary.size()));
+
+		v_compressed_sz = LZ4_compress_HC_continue(m_streamHC.get(), v_src, v_dst, v_data_sz, v_dst_sz);
+	}
+
+	if (v_compressed_sz <= 0)
+	{
+		out_data.resize(v_offset);
+		return false;
+	}
+
+	out_data.resize(v_offset + std::size_t(v_compressed_sz));
+	return true;
+}
+
+bool LuaCompressor::decompress(std::span<const std::byte> data, std::vector<std::uint8_t>& out_data, std::size_t& out_size,
+	std::size_t max_size) const
+{
+	if (data.empty() || data.size() > std::size_t(LZ4_MAX_INPUT_SIZE))
+		return false;
+
+	// The size is known before anything is allocated, so garbage that gets past the scan costs
+	// one allocation of at most 255 times its own size
+	std::size_t v_decomp_sz;
+	if (!LuaCompressor::GetDecompressedSize(data, m_dictionary.size(),
+		std::min(max_size, std::size_t(LZ4_MAX_INPUT_SIZE)), v_decomp_sz))
+	{
+		return false;
+	}
+
+	const std::size_t v_prev_size = out_data.size();
+	if (out_data.size() < v_decomp_sz)
+		out_data.resize(v_decomp_sz);
+
+	const int v_result = LZ4_decompress_safe_usingDict(
+		reinterpret_cast<const char*>(data.data()),
+		reinterpret_cast<char*>(out_data.data()),
+		int(data.size()),
+		int(v_decomp_sz),
+		reinterpret_cast<const char*>(m_dictionary.data()),
+		int(m_dictionary.size()));
+
+	if (v_result < 0 || std::size_t(v_result) != v_decomp_sz)
+	{
+		// Callers pass in buffers that are reused, which shouldn't keep what a bad block made them grow to
+		if (out_data.size() > v_prev_size)
+		{
+			out_data.resize(v_prev_size);
+			out_data.shrink_to_fit();
+		}
+
+		return false;
+	}
+
+	out_size = v_decomp_sz;
+	return true;
+}
+
+bool LuaCompressor::GetDecompressedSize(std::span<const std::byte> data, std::size_t dict_size, std::size_t max_size,
+	std::size_t& out_size)
+{
+	const std::uint8_t* v_cur = reinterpret_cast<const std::uint8_t*>(data.data());
+	const std::uint8_t* const v_end = v_cur + data.size();
+
+	// Lengths of 15 continue in the following bytes, every one of them adds up to 255
+	const auto v_read_length = [&v_cur, v_end](std::size_t& length) -> bool
+	{
+		if (length != 15)
+			return true;
+
+		for (;;)
+		{
+			if (v_cur == v_end) return false;
+
+			const std::uint8_t v_byte = *v_cur++;
+			length += v_byte;
+
+			if (v_byte != 255) return true;
+		}
+	};
+
+	std::size_t v_size = 0;
+	for (;;)
+	{
+		if (v_cur == v_end) return false;
+		const std::uint8_t v_token = *v_cur++;
+
+		std::size_t v_literal_sz = v_token >> 4;
+		if (!v_read_length(v_literal_sz)) return false;
+		if (v_literal_sz > std::size_t(v_end - v_cur)) return false;
+
+		v_cur += v_literal_sz;
+		v_size += v_literal_sz;
+		if (v_size > max_size) return false;
+
+		// The last sequence ends after its literals
+		if (v_cur == v_end)
+			break;
+
+		if (v_end - v_cur < 2) return false;
+		const std::size_t v_offset = std::size_t(v_cur[0]) | (std::size_t(v_cur[1]) << 8);
+		v_cur += 2;
+
+		// Matches can only reference what was decompressed before them and the dictionary
+		if (v_offset == 0 || v_offset > v_size + dict_size) return false;
+
+		std::size_t v_match_sz = v_token & 0xF;
+		if (!v_read_length(v_match_sz)) return false;
+
+		v_size += v_match_sz + 4;
+		if (v_size > max_size) return false;
+	}
+
+	out_size = v_size;
+	return true;
+}
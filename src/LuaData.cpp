@@ -1,12 +1,25 @@
 #include "LuaData.hpp"
+#include "LuaThreadPool.hpp"
+#include "LuaBase64.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <charconv>
 
-#include <base64.h>
 #include <lz4/lz4.h>
 
+void LuaData::copyHashCache(const LuaData& other)
+{
+	// The source can be hashed on another thread meanwhile, the target belongs to the caller
+	const bool v_is_cached = other.m_isHashCached.load(std::memory_order_acquire);
+	m_hashCache.store(other.m_hashCache.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	m_isHashCached.store(v_is_cached, std::memory_order_relaxed);
+}
+
 void LuaData::copyAssignData(const LuaData& other)
 {
+	this->copyHashCache(other);
+
 	switch (other.m_type)
 	{
 	case DataType_Boolean:
@@ -17,10 +30,18 @@ void LuaData::copyAssignData(const LuaData& other)
 		break;
 	case DataType_String:
 	case DataType_Json:
-		new (&m_string) std::string(other.m_string);
+		this->assignString(other.getString(), std::pmr::get_default_resource());
+		break;
+	case DataType_Atom:
+		// Copies don't reference the pool, just like they don't reference the resource of their source
+		m_type = DataType_String;
+		this->assignString(other.m_atom->m_string, std::pmr::get_default_resource());
+
+		m_hashCache.store(LuaData::HashString(other.m_atom->m_hash), std::memory_order_relaxed);
+		m_isHashCached.store(true, std::memory_order_relaxed);
 		break;
 	case DataType_Table:
-		new (&m_table) LuaData::TableType(other.m_table);
+		this->assignTable(LuaData::TableType(*other.m_table));
 		break;
 	case DataType_Int32:
 		m_int32 = other.m_int32;
@@ -41,6 +62,8 @@ void LuaData::copyAssignData(const LuaData& other)
 
 void LuaData::moveAssignData(LuaData&& other) noexcept
 {
+	this->copyHashCache(other);
+
 	switch (other.m_type)
 	{
 	case DataType_Boolean:
@@ -51,10 +74,25 @@ void LuaData::moveAssignData(LuaData&& other) noexcept
 		break;
 	case DataType_String:
 	case DataType_Json:
-		new (&m_string) std::string(std::move(other.m_string));
+		m_isSmallString = other.m_isSmallString;
+		m_smallSize = other.m_smallSize;
+
+		if (m_isSmallString)
+		{
+			std::copy_n(other.m_smallString, LuaData::SmallStringSize, m_smallString);
+			break;
+		}
+
+		// The allocation changes hands, so other can't free it anymore
+		m_string = other.m_string;
+		other.m_type = DataType_None;
+		break;
+	case DataType_Atom:
+		m_atom = other.m_atom;
 		break;
 	case DataType_Table:
-		new (&m_table) LuaData::TableType(std::move(other.m_table));
+		m_table = other.m_table;
+		other.m_type = DataType_None;
 		break;
 	case DataType_Int32:
 		m_int32 = other.m_int32;
@@ -79,14 +117,71 @@ void LuaData::clearData()
 	{
 	case DataType_String:
 	case DataType_Json:
-		m_string.~basic_string();
+		if (!m_isSmallString)
+			std::pmr::polymorphic_allocator<LuaData::StringType>(m_string->get_allocator()).delete_object(m_string);
+
 		break;
 	case DataType_Table:
-		m_table.~map();
+		std::pmr::polymorphic_allocator<LuaData::TableType>(m_table->getResource()).delete_object(m_table);
+		break;
+	default:
 		break;
 	}
 }
 
+void LuaData::assignString(std::string_view str, std::pmr::memory_resource* resource)
+{
+	m_isSmallString = str.size() <= LuaData::SmallStringSize;
+	if (m_isSmallString)
+	{
+		m_smallSize = std::uint8_t(str.size());
+		std::copy_n(str.data(), str.size(), m_smallString);
+		return;
+	}
+
+	m_string = std::pmr::polymorphic_allocator<LuaData::StringType>(resource).new_object<LuaData::StringType>(str);
+}
+
+void LuaData::assignString(StringType&& str)
+{
+	if (str.size() <= LuaData::SmallStringSize)
+	{
+		this->assignString(std::string_view(str), nullptr);
+		return;
+	}
+
+	// Allocated from the resource of the string, so its characters are moved instead of copied
+	m_isSmallString = false;
+	m_string = std::pmr::polymorphic_allocator<LuaData::StringType>(str.get_allocator()).new_object<LuaData::StringType>(std::move(str));
+}
+
+void LuaData::assignTable(TableType&& table)
+{
+	m_table = std::pmr::polymorphic_allocator<LuaData::TableType>(table.getResource()).new_object<LuaData::TableType>(std::move(table));
+}
+
+LuaData::StringType& LuaData::getMutableString()
+{
+	m_isHashCached.store(false, std::memory_order_relaxed);
+
+	// The atom belongs to its pool, the value gets a string of its own that can be modified
+	if (m_type == DataType_Atom)
+	{
+		const std::string_view v_atom_str = m_atom->m_string;
+		m_type = DataType_String;
+		m_isSmallString = false;
+		m_string = std::pmr::polymorphic_allocator<LuaData::StringType>().new_object<LuaData::StringType>(v_atom_str);
+	}
+	else if (m_isSmallString)
+	{
+		const std::string_view v_small_str(m_smallString, m_smallSize);
+		m_isSmallString = false;
+		m_string = std::pmr::polymorphic_allocator<LuaData::StringType>().new_object<LuaData::StringType>(v_small_str);
+	}
+
+	return *m_string;
+}
+
 void LuaData::operator=(LuaData&& other) noexcept
 {
 	this->clearData();
@@ -108,61 +203,223 @@ bool LuaData::operator<(const LuaData& rhs) const
 	return this->getHash() < rhs.getHash();
 }
 
-void LuaData::toString(std::string& out_string) const
+bool LuaData::operator==(const LuaData& rhs) const
 {
+	// Atoms of one pool are unique, so only atoms of different pools need the characters compared
+	if (this->isString() && rhs.isString())
+	{
+		if (m_type == DataType_Atom && rhs.m_type == DataType_Atom)
+		{
+			if (m_atom == rhs.m_atom)
+				return true;
+
+			if (m_atom->m_hash != rhs.m_atom->m_hash)
+				return false;
+		}
+
+		return this->getString() == rhs.getString();
+	}
+
+	if (m_type != rhs.m_type)
+		return false;
+
 	switch (m_type)
 	{
-	case DataType_Nil:
-		out_string.append("nil", 3);
-		break;
 	case DataType_Boolean:
-		out_string.append(m_boolean ? "true" : "false");
-		break;
+		return m_boolean == rhs.m_boolean;
 	case DataType_Number:
-		out_string.append(std::to_string(m_number));
-		break;
+		return m_number == rhs.m_number;
 	case DataType_String:
-		out_string.append("\"" + m_string + "\"");
-		break;
+	case DataType_Json:
+		return this->getString() == rhs.getString();
 	case DataType_Table:
+		return *m_table == *rhs.m_table;
+	case DataType_Int32:
+		return m_int32 == rhs.m_int32;
+	case DataType_Int16:
+		return m_int16 == rhs.m_int16;
+	case DataType_Int8:
+		return m_int8 == rhs.m_int8;
+	case DataType_Userdata:
+		return m_luaTypeId == rhs.m_luaTypeId;
+	default:
+		return true;
+	}
+}
+
+// Writes toString straight into the output, or only counts the characters when there is none
+class LuaDataFormatter
+{
+public:
+	LuaDataFormatter(std::string* out_string, const ToStringOptions& options)
+		: m_out(out_string), m_options(options), m_length(0), m_isTruncated(false) {}
+
+	inline std::size_t getLength() const { return m_length; }
+
+	void write(const LuaData& data, std::size_t depth)
+	{
+		switch (data.m_type)
+		{
+		case DataType_Nil:
+			this->append("nil");
+			break;
+		case DataType_Boolean:
+			this->append(data.m_boolean ? "true" : "false");
+			break;
+		case DataType_Number:
+			// Same as std::to_string
+			this->appendNumber(double(data.m_number), std::chars_format::fixed, 6);
+			break;
+		case DataType_String:
+		case DataType_Atom:
+			this->append("\"");
+			this->append(data.getString());
+			this->append("\"");
+			break;
+		case DataType_Table:
+			this->writeTable(*data.m_table, depth + 1);
+			break;
+		case DataType_Int32:
+			this->appendNumber(data.m_int32);
+			break;
+		case DataType_Int16:
+			this->appendNumber(data.m_int16);
+			break;
+		case DataType_Int8:
+			this->appendNumber(data.m_int8);
+			break;
+		case DataType_Json:
+			this->append("<Json = \"");
+			this->append(data.getString());
+			this->append("\">");
+			break;
+		default:
+			this->append("UNKNOWN TYPE ");
+			this->appendNumber(std::uint8_t(data.m_type));
+			break;
+		}
+	}
+
+private:
+	void writeTable(const LuaData::TableType& table, std::size_t depth)
 	{
+		if (depth > m_options.m_maxDepth)
+		{
+			this->append("{ ... }");
+			return;
+		}
+
+		if (m_options.m_indent == 0)
+		{
+			bool add_comma = false;
+			this->append("{ ");
+
+			for (const auto& [v_key, v_value] : table)
+			{
+				if (m_isTruncated) return;
+
+				if (add_comma) this->append(", ");
+				add_comma = true;
+
+				this->append("[");
+				this->write(v_key, depth);
+				this->append("] = ");
+				this->write(v_value, depth);
+			}
+
+			this->append(" }");
+			return;
+		}
+
+		if (table.empty())
+		{
+			this->append("{}");
+			return;
+		}
+
 		bool add_comma = false;
-		out_string.append("{ ");
+		this->append("{");
 
-		for (const auto& [v_key, v_value] : m_table)
+		for (const auto& [v_key, v_value] : table)
 		{
-			if (add_comma) out_string.append(", ");
+			if (m_isTruncated) return;
+
+			if (add_comma) this->append(",");
 			add_comma = true;
 
-			std::string v_key_str, v_value_str;
-			v_key.toString(v_key_str);
-			v_value.toString(v_value_str);
+			this->appendNewLine(depth);
+			this->append("[");
+			this->write(v_key, depth);
+			this->append("] = ");
+			this->write(v_value, depth);
+		}
+
+		this->appendNewLine(depth - 1);
+		this->append("}");
+	}
+
+	void appendNewLine(std::size_t depth)
+	{
+		this->append("\n");
+
+		std::size_t v_count = depth * m_options.m_indent;
+		if (m_isTruncated || v_count == 0)
+			return;
 
-			out_string.append("[", 1);
-			out_string.append(v_key_str);
-			out_string.append("] = ");
-			out_string.append(v_value_str);
+		if (v_count > m_options.m_maxLength - m_length)
+		{
+			v_count = m_options.m_maxLength - m_length;
+			m_isTruncated = true;
 		}
 
-		out_string.append(" }");
-		break;
+		if (m_out)
+		{
+			m_out->append(v_count, ' ');
+			if (m_isTruncated) m_out->append("...", 3);
+		}
+
+		m_length += v_count + (m_isTruncated ? 3 : 0);
 	}
-	case DataType_Int32:
-		out_string.append(std::to_string(m_int32));
-		break;
-	case DataType_Int16:
-		out_string.append(std::to_string(m_int16));
-		break;
-	case DataType_Int8:
-		out_string.append(std::to_string(m_int8));
-		break;
-	case DataType_Json:
-		out_string.append("<Json = \"" + m_string + "\">");
-		break;
-	default:
-		out_string.append("UNKNOWN TYPE " + std::to_string(m_type));
-		break;
+
+	template<typename T, typename ...Args>
+	void appendNumber(T number, Args... args)
+	{
+		char v_buffer[64];
+		const std::to_chars_result v_result = std::to_chars(v_buffer, v_buffer + sizeof(v_buffer), number, args...);
+
+		this->append(std::string_view(v_buffer, std::size_t(v_result.ptr - v_buffer)));
+	}
+
+	void append(std::string_view str)
+	{
+		if (m_isTruncated)
+			return;
+
+		if (str.size() > m_options.m_maxLength - m_length)
+		{
+			str = str.substr(0, m_options.m_maxLength - m_length);
+			m_isTruncated = true;
+		}
+
+		if (m_out)
+		{
+			m_out->append(str);
+			if (m_isTruncated) m_out->append("...", 3);
+		}
+
+		m_length += str.size() + (m_isTruncated ? 3 : 0);
 	}
+
+	std::string* m_out;
+	const ToStringOptions& m_options;
+	std::size_t m_length;
+	bool m_isTruncated;
+};
+
+void LuaData::toString(std::string& out_string, const ToStringOptions& options) const
+{
+	LuaDataFormatter v_formatter(&out_string, options);
+	v_formatter.write(*this, 0);
 }
 
 std::string LuaData::toString2() const
@@ -173,6 +430,14 @@ std::string LuaData::toString2() const
 	return v_out_str;
 }
 
+std::size_t LuaData::getStringSize(const ToStringOptions& options) const
+{
+	LuaDataFormatter v_formatter(nullptr, options);
+	v_formatter.write(*this, 0);
+
+	return v_formatter.getLength();
+}
+
 std::size_t LuaData::getTypeData() const
 {
 	switch (m_type)
@@ -180,12 +445,14 @@ std::size_t LuaData::getTypeData() const
 	case DataType_Boolean:
 		return std::size_t(m_boolean);
 	case DataType_Number:
-		return std::size_t(*reinterpret_cast<const std::uint32_t*>(&m_number));
+		return std::size_t(std::bit_cast<std::uint32_t>(m_number));
 	case DataType_String:
 	case DataType_Json:
-		return m_string.size();
+		return this->getString().size();
 	case DataType_Table:
-		return m_table.size();
+		return m_table->size();
+	case DataType_Atom:
+		return m_atom->m_string.size();
 	case DataType_Int32:
 		return std::size_t(m_int32);
 	case DataType_Int16:
@@ -207,7 +474,25 @@ std::size_t LuaData::getHash() const
 		return std::hash<bool>{}(m_boolean);
 	case DataType_String:
 	case DataType_Json:
-		return std::hash<std::string>{}(m_string);
+		if (!m_isHashCached.load(std::memory_order_acquire))
+		{
+			// Threads that race here compute the same hash, so it doesn't matter which store wins
+			m_hashCache.store(LuaData::HashString(std::hash<std::string_view>{}(this->getString())), std::memory_order_relaxed);
+			m_isHashCached.store(true, std::memory_order_release);
+		}
+
+		return std::size_t(m_hashCache.load(std::memory_order_relaxed));
+	case DataType_Atom:
+		return std::size_t(LuaData::HashString(m_atom->m_hash));
+	case DataType_Table:
+	{
+		// Entries are combined with a sum, since the order of the hash part doesn't affect equality
+		std::size_t v_hash = m_table->size();
+		for (const auto& [v_key, v_value] : *m_table)
+			v_hash += (v_key.getHash() * std::size_t(0x9E3779B97F4A7C15ull)) ^ v_value.getHash();
+
+		return v_hash;
+	}
 	case DataType_Number:
 		return std::hash<decltype(m_number)>{}(m_number);
 	case DataType_Int32:
@@ -221,10 +506,183 @@ std::size_t LuaData::getHash() const
 	}
 }
 
-bool LuaData::DeserializeInternal(BitReader& reader, LuaData& out_data)
+bool LuaData::DeserializeInternal(BitReader& reader, LuaData& out_data, const DecodeContext& context, bool is_key)
+{
+	LuaData::TableHeader v_header;
+	if (!LuaData::DeserializeValue(reader, out_data, v_header, context, is_key))
+		return false;
+
+	if (out_data.m_type != DataType_Table)
+		return true;
+
+	const std::size_t v_entries_start = reader.m_dataIndex;
+
+	LuaData::TableType& v_table = *out_data.m_table;
+	if (context.m_threadPool != nullptr && v_header.m_itemCount >= LuaData::ParallelMinCount)
+	{
+		if (!LuaData::DeserializeEntriesParallel(reader, v_table, v_header, context)) return false;
+	}
+	else for (std::uint32_t a = 0; a < v_header.m_itemCount; a++)
+	{
+		if (v_header.m_isArray)
+		{
+			LuaData v_tblValue;
+			if (!LuaData::DeserializeInternal(reader, v_tblValue, context)) return false;
+
+			LuaData::InsertArrayItem(v_table, v_header, a, std::move(v_tblValue));
+			continue;
+		}
+
+		LuaData v_tblKey, v_tblValue;
+
+		// Read the key
+		if (!LuaData::DeserializeInternal(reader, v_tblKey, context, true)) return false;
+		// Read the value
+		if (!LuaData::DeserializeInternal(reader, v_tblValue, context)) return false;
+
+		v_table.emplace(std::move(v_tblKey), std::move(v_tblValue));
+	}
+
+	// A size that doesn't match the entries means that the blob is corrupted
+	if (v_header.m_hasEntriesSize && reader.m_dataIndex - v_entries_start != v_header.m_entriesSize)
+		return false;
+
+	return true;
+}
+
+struct LuaData::DecodeFrame
+{
+	LuaData m_table;
+	TableHeader m_header;
+	std::uint32_t m_itemIdx;
+	std::size_t m_entriesStart;
+	// Key of the next entry once it's read, hash tables only
+	LuaData m_key;
+	bool m_hasKey;
+};
+
+bool LuaData::DeserializeStack(BitReader& reader, LuaData& out_data, const DecodeContext& context)
+{
+	std::vector<LuaData::DecodeFrame>& v_stack = LuaData::GetScratchBuffers().m_decodeStack;
+	const bool v_success = LuaData::DeserializeStackEntries(reader, out_data, v_stack, context);
+
+	// The frames of a failed blob are released here, while their memory resource is still alive
+	v_stack.clear();
+	return v_success;
+}
+
+bool LuaData::DeserializeStackEntries(BitReader& reader, LuaData& out_data, std::vector<DecodeFrame>& stack,
+	const DecodeContext& context)
+{
+	LuaData::TableHeader v_header;
+	if (!LuaData::DeserializeValue(reader, out_data, v_header, context, false))
+		return false;
+
+	if (out_data.m_type != DataType_Table)
+		return true;
+
+	// The entries of a table follow right after its header
+	const auto v_push_table = [&](LuaData& table) -> bool
+	{
+		if (stack.size() >= context.m_maxDepth)
+			return false;
+
+		stack.push_back(LuaData::DecodeFrame{ std::move(table), v_header, 0, reader.m_dataIndex, LuaData(), false });
+		return true;
+	};
+
+	if (!v_push_table(out_data))
+		return false;
+
+	while (true)
+	{
+		const std::size_t v_depth = stack.size();
+		LuaData::DecodeFrame& v_frame = stack.back();
+		LuaData::TableType& v_table = *v_frame.m_table.m_table;
+
+		// Entries are read up to the next table, which pushes its frame and invalidates v_frame
+		while (v_frame.m_itemIdx < v_frame.m_header.m_itemCount)
+		{
+			const bool v_is_key = !v_frame.m_header.m_isArray && !v_frame.m_hasKey;
+
+			LuaData v_value;
+			if (!LuaData::DeserializeValue(reader, v_value, v_header, context, v_is_key)) return false;
+
+			if (v_value.m_type == DataType_Table)
+			{
+				if (!v_push_table(v_value)) return false;
+				break;
+			}
+
+			if (v_frame.m_header.m_isArray)
+			{
+				LuaData::InsertArrayItem(v_table, v_frame.m_header, v_frame.m_itemIdx++, std::move(v_value));
+			}
+			else if (v_is_key)
+			{
+				// The value is read right away, so the key only goes into the frame in front of a table
+				LuaData v_item;
+				if (!LuaData::DeserializeValue(reader, v_item, v_header, context, false)) return false;
+
+				if (v_item.m_type == DataType_Table)
+				{
+					v_frame.m_key = std::move(v_value);
+					v_frame.m_hasKey = true;
+
+					if (!v_push_table(v_item)) return false;
+					break;
+				}
+
+				v_table.emplace(std::move(v_value), std::move(v_item));
+				v_frame.m_itemIdx++;
+			}
+			else
+			{
+				v_table.emplace(std::move(v_frame.m_key), std::move(v_value));
+				v_frame.m_hasKey = false;
+				v_frame.m_itemIdx++;
+			}
+		}
+
+		if (stack.size() != v_depth)
+			continue;
+
+		// A size that doesn't match the entries means that the blob is corrupted
+		if (v_frame.m_header.m_hasEntriesSize && reader.m_dataIndex - v_frame.m_entriesStart != v_frame.m_header.m_entriesSize)
+			return false;
+
+		if (v_depth == 1)
+		{
+			out_data = std::move(v_frame.m_table);
+			return true;
+		}
+
+		LuaData v_done(std::move(v_frame.m_table));
+		stack.pop_back();
+
+		LuaData::DecodeFrame& v_parent = stack.back();
+		if (v_parent.m_header.m_isArray)
+		{
+			LuaData::InsertArrayItem(*v_parent.m_table.m_table, v_parent.m_header, v_parent.m_itemIdx++, std::move(v_done));
+		}
+		else if (!v_parent.m_hasKey)
+		{
+			v_parent.m_key = std::move(v_done);
+			v_parent.m_hasKey = true;
+		}
+		else
+		{
+			v_parent.m_table.m_table->emplace(std::move(v_parent.m_key), std::move(v_done));
+			v_parent.m_hasKey = false;
+			v_parent.m_itemIdx++;
+		}
+	}
+}
+
+bool LuaData::DeserializeValue(BitReader& reader, LuaData& out_data, TableHeader& out_header, const DecodeContext& context, bool is_key)
 {
 	DataType v_type = DataType_None;
-	reader.readObject<DataType>(&v_type);
+	if (!LuaData::ReadType(reader, v_type, context.m_version)) return false;
 
 	switch (v_type)
 	{
@@ -250,52 +708,48 @@ bool LuaData::DeserializeInternal(BitReader& reader, LuaData& out_data)
 	case DataType_String:
 	{
 		std::uint32_t v_string_sz;
-		if (!reader.readObject<std::uint32_t, true>(&v_string_sz)) return false;
+		if (!LuaData::ReadSize(reader, v_string_sz, context.m_version)) return false;
 		reader.alignIndex();
+		if (!reader.isEnoughData(std::size_t(v_string_sz) * 8)) return false;
+
+		// The string is byte aligned, so it's copied or interned straight from the input
+		const std::string_view v_string(
+			reinterpret_cast<const char*>(reader.m_dataPtr) + (reader.m_dataIndex >> 3), v_string_sz);
+		reader.m_dataIndex += std::size_t(v_string_sz) * 8;
+
+		if (is_key && context.m_atomPool != nullptr)
+		{
+			if (context.m_atomMutex != nullptr)
+			{
+				std::lock_guard<std::mutex> v_lock(*context.m_atomMutex);
+				new (&out_data) LuaData(context.m_atomPool->intern(v_string));
+			}
+			else
+			{
+				new (&out_data) LuaData(context.m_atomPool->intern(v_string));
+			}
 
-		std::string v_final_str(v_string_sz, ' ');
-		if (!reader.readBits(v_final_str.data(), v_final_str.size() * 8)) return false;
+			break;
+		}
 
-		new (&out_data) LuaData(std::move(v_final_str));
+		new (&out_data) LuaData(v_string, context.m_resource);
 		break;
 	}
 	case DataType_Table:
 	{
-		std::uint32_t v_arr_item_count;
-		if (!reader.readObject<std::uint32_t, true>(&v_arr_item_count)) return false;
-
-		bool v_is_array = false;
-		if (!reader.readBit(&v_is_array)) return false;
-
-		std::map<LuaData, LuaData> v_table_def = {};
-
-		if (v_is_array)
-		{
-			std::uint32_t v_item_offset;
-			reader.readObject<std::uint32_t, true>(&v_item_offset);
-
-			for (std::uint32_t a = 0; a < v_arr_item_count; a++)
-			{
-				LuaData v_tblValue;
-				if (!LuaData::DeserializeInternal(reader, v_tblValue)) return false;
+		if (!LuaData::ReadTableHeader(reader, out_header, context.m_version)) return false;
 
-				v_table_def.emplace(std::int32_t(a), std::move(v_tblValue));
-			}
-		}
-		else
-		{
-			for (std::uint32_t a = 0; a < v_arr_item_count; a++)
-			{
-				LuaData v_tblKey, v_tblValue;
+		// Every entry takes at least 8 bits, so a bogus count can't reserve more than the input size
+		const std::size_t v_reserve_count = std::min<std::size_t>(
+			out_header.m_itemCount, (reader.m_dataSize - reader.m_dataIndex) / 8);
 
-				// Read the key
-				if (!LuaData::DeserializeInternal(reader, v_tblKey)) return false;
-				// Read the value
-				if (!LuaData::DeserializeInternal(reader, v_tblValue)) return false;
+		LuaData::TableType v_table_def(context.m_resource);
 
-				v_table_def.emplace(std::move(v_tblKey), std::move(v_tblValue));
-			}
-		}
+		// Arrays starting at 1 map directly onto the array part of the table
+		if (out_header.m_isArray && out_header.m_itemOffset == 1)
+			v_table_def.reserveArray(v_reserve_count);
+		else if (!out_header.m_isArray)
+			v_table_def.reserve(v_reserve_count);
 
 		new (&out_data) LuaData(std::move(v_table_def));
 		break;
@@ -303,7 +757,7 @@ bool LuaData::DeserializeInternal(BitReader& reader, LuaData& out_data)
 	case DataType_Int32:
 	{
 		std::int32_t v_int32;
-		if (!reader.readObject<std::int32_t, true>(&v_int32)) return false;
+		if (!LuaData::ReadInteger(reader, v_int32, context.m_version)) return false;
 
 		new (&out_data) LuaData(v_int32);
 		break;
@@ -311,7 +765,7 @@ bool LuaData::DeserializeInternal(BitReader& reader, LuaData& out_data)
 	case DataType_Int16:
 	{
 		std::int16_t v_int16;
-		if (!reader.readObject<std::int16_t, true>(&v_int16)) return false;
+		if (!LuaData::ReadInteger(reader, v_int16, context.m_version)) return false;
 
 		new (&out_data) LuaData(v_int16);
 		break;
@@ -319,7 +773,7 @@ bool LuaData::DeserializeInternal(BitReader& reader, LuaData& out_data)
 	case DataType_Int8:
 	{
 		std::int8_t v_int8;
-		if (!reader.readObject<std::int8_t, true>(&v_int8)) return false;
+		if (!LuaData::ReadInteger(reader, v_int8, context.m_version)) return false;
 
 		new (&out_data) LuaData(v_int8);
 		break;
@@ -327,13 +781,17 @@ bool LuaData::DeserializeInternal(BitReader& reader, LuaData& out_data)
 	case DataType_Json:
 	{
 		std::uint32_t v_str_sz;
-		if (!reader.readObject<std::uint32_t, true>(&v_str_sz)) return false;
+		if (!LuaData::ReadSize(reader, v_str_sz, context.m_version)) return false;
 		reader.alignIndex();
+		if (!reader.isEnoughData(std::size_t(v_str_sz) * 8)) return false;
 
-		LuaData::JsonType v_str(std::size_t(v_str_sz), ' ');
-		if (!reader.readBits(v_str.data(), v_str.size() * 8)) return false;
+		const std::string_view v_str(
+			reinterpret_cast<const char*>(reader.m_dataPtr) + (reader.m_dataIndex >> 3), v_str_sz);
+		reader.m_dataIndex += std::size_t(v_str_sz) * 8;
 
-		new (&out_data) LuaData(std::move(v_str));
+		// Stored just like a string
+		new (&out_data) LuaData(v_str, context.m_resource);
+		out_data.m_type = DataType_Json;
 		break;
 	}
 	case DataType_Userdata:
@@ -346,82 +804,402 @@ bool LuaData::DeserializeInternal(BitReader& reader, LuaData& out_data)
 	return true;
 }
 
-bool LuaData::DeserializeHeader(BitReader& reader)
+bool LuaData::ReadTableHeader(BitReader& reader, TableHeader& out_header, FormatVersion version)
 {
-	int v_lua_magic = 0;
-	if (!reader.readBits(&v_lua_magic, std::size_t(3 * 8)))
-		return false;
-
-	if (v_lua_magic != int('AUL'))
-	{
-		std::cout << "Invalid lua secret\n";
-		return false;
-	}
+	if (!LuaData::ReadSize(reader, out_header.m_itemCount, version)) return false;
+	if (!reader.readBit(&out_header.m_isArray)) return false;
 
-	std::uint32_t v_version;
-	if (!reader.readObject<std::uint32_t, true>(&v_version))
+	out_header.m_itemOffset = 0;
+	if (out_header.m_isArray && !LuaData::ReadSize(reader, out_header.m_itemOffset, version))
 		return false;
 
-	if (v_version != 1)
+	out_header.m_hasEntriesSize = false;
+	out_header.m_entriesSize = 0;
+	if (version >= FormatVersion_2)
 	{
-		std::cout << "Invalid object version\n";
-		return false;
+		if (!reader.readBit(&out_header.m_hasEntriesSize)) return false;
+
+		if (out_header.m_hasEntriesSize && !reader.readObject<std::uint32_t, true>(&out_header.m_entriesSize))
+			return false;
 	}
 
 	return true;
 }
 
-bool LuaData::SerializeBody(BitWriter& writer, const LuaData& data)
+bool LuaData::SkipValue(BitReader& reader, FormatVersion version)
 {
-	writer.writeObject<DataType>(data.m_type);
-
-	switch (data.m_type)
-	{
-	case DataType_Nil:
-		break;
-	case DataType_Boolean:
-		writer.writeBit(data.m_boolean);
-		break;
-	case DataType_Number:
-		writer.writeObject<float, true>(data.m_number);
-		break;
-	case DataType_String:
+	// Values that still have to be skipped. Tables add their entries, so nested tables don't recurse
+	std::uint64_t v_pending = 1;
+	while (v_pending > 0)
 	{
-		writer.writeObject<std::uint32_t, true>(std::uint32_t(data.m_string.size()));
-		writer.alignIndex();
+		v_pending--;
 
-		writer.writeBits(data.m_string.data(), data.m_string.size() * 8);
-		break;
-	}
-	case DataType_Table:
+		DataType v_type = DataType_None;
+		if (!LuaData::ReadType(reader, v_type, version)) return false;
+
+		std::size_t v_skip_bits = 0;
+		switch (v_type)
+		{
+		case DataType_Nil:
+			break;
+		case DataType_Boolean:
+			v_skip_bits = 1;
+			break;
+		case DataType_Number:
+			v_skip_bits = 32;
+			break;
+		case DataType_Int32:
+		{
+			std::int32_t v_int32;
+			if (!LuaData::ReadInteger(reader, v_int32, version)) return false;
+			break;
+		}
+		case DataType_Int16:
+		{
+			std::int16_t v_int16;
+			if (!LuaData::ReadInteger(reader, v_int16, version)) return false;
+			break;
+		}
+		case DataType_Int8:
+		{
+			std::int8_t v_int8;
+			if (!LuaData::ReadInteger(reader, v_int8, version)) return false;
+			break;
+		}
+		case DataType_String:
+		case DataType_Json:
+		{
+			std::uint32_t v_str_sz;
+			if (!LuaData::ReadSize(reader, v_str_sz, version)) return false;
+			reader.alignIndex();
+
+			v_skip_bits = std::size_t(v_str_sz) * 8;
+			break;
+		}
+		case DataType_Table:
+		{
+			LuaData::TableHeader v_header;
+			if (!LuaData::ReadTableHeader(reader, v_header, version)) return false;
+
+			if (v_header.m_hasEntriesSize)
+				v_skip_bits = v_header.m_entriesSize;
+			else
+				v_pending += v_header.m_isArray ? std::uint64_t(v_header.m_itemCount) : std::uint64_t(v_header.m_itemCount) * 2;
+
+			break;
+		}
+		default:
+			return false;
+		}
+
+		if (!reader.isEnoughData(v_skip_bits)) return false;
+		reader.m_dataIndex += v_skip_bits;
+	}
+
+	return true;
+}
+
+bool LuaData::ValidateBody(BitReader& reader, const ValidateLimits& limits, ValidateResult& out_result)
+{
+	static constexpr std::size_t NoEntriesEnd = std::numeric_limits<std::size_t>::max();
+
+	const FormatVersion v_version = out_result.m_version;
+	// Strings up to this size don't allocate any characters once they are in their own allocation
+	const std::size_t v_inline_capacity = LuaData::StringType().capacity();
+	// Smallest possible value, a nil
+	const std::size_t v_min_value_bits = (v_version >= FormatVersion_3) ? LuaData::CompactTypeBits : 8;
+
+	// Nested tables push a frame instead of recursing, so deep blobs can't exhaust the stack
+	std::vector<ValidateFrame>& v_stack = LuaData::GetScratchBuffers().m_validateStack;
+	v_stack.clear();
+	v_stack.push_back({ 1, NoEntriesEnd });
+
+	std::uint64_t v_value_count = 1;
+	if (v_value_count > limits.m_maxValues) return false;
+
+	for (;;)
+	{
+		ValidateFrame& v_frame = v_stack.back();
+		if (v_frame.m_pendingCount == 0)
+		{
+			// A size that doesn't match the entries means that the blob is corrupted
+			if (v_frame.m_entriesEnd != NoEntriesEnd && reader.m_dataIndex != v_frame.m_entriesEnd) return false;
+
+			v_stack.pop_back();
+			if (v_stack.empty()) break;
+
+			continue;
+		}
+
+		v_frame.m_pendingCount--;
+
+		DataType v_type = DataType_None;
+		if (!LuaData::ReadType(reader, v_type, v_version)) return false;
+
+		std::size_t v_skip_bits = 0;
+		switch (v_type)
+		{
+		case DataType_Nil:
+			break;
+		case DataType_Boolean:
+			v_skip_bits = 1;
+			break;
+		case DataType_Number:
+			v_skip_bits = 32;
+			break;
+		case DataType_Int32:
+		{
+			std::int32_t v_int32;
+			if (!LuaData::ReadInteger(reader, v_int32, v_version)) return false;
+			break;
+		}
+		case DataType_Int16:
+		{
+			std::int16_t v_int16;
+			if (!LuaData::ReadInteger(reader, v_int16, v_version)) return false;
+			break;
+		}
+		case DataType_Int8:
+		{
+			std::int8_t v_int8;
+			if (!LuaData::ReadInteger(reader, v_int8, v_version)) return false;
+			break;
+		}
+		case DataType_String:
+		case DataType_Json:
+		{
+			std::uint32_t v_str_sz;
+			if (!LuaData::ReadSize(reader, v_str_sz, v_version)) return false;
+			if (v_str_sz > limits.m_maxStringSize) return false;
+			reader.alignIndex();
+
+			v_skip_bits = std::size_t(v_str_sz) * 8;
+
+			out_result.m_stringSize += v_str_sz;
+			if (v_str_sz > LuaData::SmallStringSize)
+				out_result.m_memoryEstimate += sizeof(LuaData::StringType);
+			if (v_str_sz > v_inline_capacity)
+				out_result.m_memoryEstimate += std::size_t(v_str_sz) + 1;
+
+			break;
+		}
+		case DataType_Table:
+		{
+			LuaData::TableHeader v_header;
+			if (!LuaData::ReadTableHeader(reader, v_header, v_version)) return false;
+
+			// The frame of the outermost table is the second one
+			const std::size_t v_depth = v_stack.size();
+			if (v_depth > limits.m_maxDepth) return false;
+
+			// Bogus counts are rejected right away instead of after reading the whole input
+			const std::uint64_t v_entry_count = v_header.m_isArray
+				? std::uint64_t(v_header.m_itemCount) : std::uint64_t(v_header.m_itemCount) * 2;
+			if (v_entry_count > (reader.m_dataSize - reader.m_dataIndex) / v_min_value_bits) return false;
+
+			v_value_count += v_entry_count;
+			if (v_value_count > limits.m_maxValues) return false;
+
+			out_result.m_tableCount++;
+			out_result.m_maxDepth = std::max(out_result.m_maxDepth, v_depth);
+			out_result.m_memoryEstimate += sizeof(LuaData::TableType) + LuaData::TableType::GetReservedSize(
+				v_header.m_itemCount, v_header.m_isArray && v_header.m_itemOffset == 1);
+
+			v_stack.push_back({ v_entry_count,
+				v_header.m_hasEntriesSize ? reader.m_dataIndex + v_header.m_entriesSize : NoEntriesEnd });
+			break;
+		}
+		default:
+			return false;
+		}
+
+		if (!reader.isEnoughData(v_skip_bits)) return false;
+		reader.m_dataIndex += v_skip_bits;
+	}
+
+	out_result.m_valueCount = std::size_t(v_value_count);
+	return true;
+}
+
+bool LuaData::DeserializeEntriesParallel(BitReader& reader, TableType& table, const TableHeader& header, const DecodeContext& context)
+{
+	LuaThreadPool& v_pool = *context.m_threadPool;
+
+	const std::uint32_t v_chunk_count = std::max<std::uint32_t>(1, std::min<std::uint32_t>(
+		std::uint32_t(v_pool.getThreadCount() + 1) * LuaData::ParallelChunksPerThread,
+		header.m_itemCount / LuaData::ParallelMinChunkSize));
+	const std::uint32_t v_chunk_size = (header.m_itemCount + v_chunk_count - 1) / v_chunk_count;
+
+	struct Chunk
+	{
+		std::size_t m_start;
+		std::size_t m_end;
+		std::uint32_t m_itemCount;
+		// Keys and values take turns unless the table is an array
+		std::vector<LuaData> m_values;
+		bool m_success;
+	};
+
+	std::vector<Chunk> v_chunks;
+	v_chunks.reserve(v_chunk_count);
+
+	for (std::uint32_t a = 0; a < header.m_itemCount; a += v_chunk_size)
+	{
+		const std::uint32_t v_item_count = std::min(v_chunk_size, header.m_itemCount - a);
+		const std::uint64_t v_value_count = header.m_isArray ? v_item_count : std::uint64_t(v_item_count) * 2;
+
+		Chunk& v_chunk = v_chunks.emplace_back();
+		v_chunk.m_start = reader.m_dataIndex;
+		v_chunk.m_itemCount = v_item_count;
+		v_chunk.m_success = false;
+
+		for (std::uint64_t b = 0; b < v_value_count; b++)
+			if (!LuaData::SkipValue(reader, context.m_version)) return false;
+
+		v_chunk.m_end = reader.m_dataIndex;
+	}
+
+	LuaThreadPool::TaskGroup v_group;
+	for (Chunk& v_chunk : v_chunks)
+	{
+		v_pool.run(v_group, [&v_chunk, &reader, &header, &context]() {
+			BitReader v_reader = reader;
+			v_reader.m_dataIndex = v_chunk.m_start;
+
+			const std::size_t v_value_count = header.m_isArray ? v_chunk.m_itemCount : std::size_t(v_chunk.m_itemCount) * 2;
+			v_chunk.m_values.resize(v_value_count);
+
+			for (std::size_t a = 0; a < v_value_count; a++)
+			{
+				const bool v_is_key = !header.m_isArray && (a & 1) == 0;
+				if (!LuaData::DeserializeInternal(v_reader, v_chunk.m_values[a], context, v_is_key)) return;
+			}
+
+			v_chunk.m_success = (v_reader.m_dataIndex == v_chunk.m_end);
+		});
+	}
+
+	v_pool.wait(v_group);
+
+	// Inserting in order keeps the first of duplicate keys, just like the sequential decoder
+	std::uint32_t v_item_idx = 0;
+	for (Chunk& v_chunk : v_chunks)
+	{
+		if (!v_chunk.m_success)
+			return false;
+
+		if (header.m_isArray)
+		{
+			for (LuaData& v_value : v_chunk.m_values)
+				LuaData::InsertArrayItem(table, header, v_item_idx++, std::move(v_value));
+
+			continue;
+		}
+
+		for (std::size_t a = 0; a < v_chunk.m_values.size(); a += 2)
+			table.emplace(std::move(v_chunk.m_values[a]), std::move(v_chunk.m_values[a + 1]));
+	}
+
+	return true;
+}
+
+void LuaData::InsertArrayItem(TableType& table, const TableHeader& header, std::uint32_t item_idx, LuaData&& value)
+{
+	if (header.m_itemOffset == 1)
+		table.appendArray(std::move(value));
+	else
+		table.emplace(std::int32_t(header.m_itemOffset + item_idx), std::move(value));
+}
+
+bool LuaData::DeserializeHeader(BitReader& reader, FormatVersion& out_version)
+{
+	int v_lua_magic = 0;
+	if (!reader.readBits(&v_lua_magic, std::size_t(3 * 8)))
+		return false;
+
+	if (v_lua_magic != int('AUL'))
+	{
+		std::cout << "Invalid lua secret\n";
+		return false;
+	}
+
+	std::uint32_t v_version;
+	if (!reader.readObject<std::uint32_t, true>(&v_version))
+		return false;
+
+	if (v_version < FormatVersion_1 || v_version > FormatVersion_3)
+	{
+		std::cout << "Invalid object version\n";
+		return false;
+	}
+
+	out_version = FormatVersion(v_version);
+	return true;
+}
+
+bool LuaData::SerializeBody(BitWriter& writer, const LuaData& data, const EncodeContext& context)
+{
+	LuaData::WriteType(writer, data.m_type == DataType_Atom ? DataType_String : data.m_type, context.m_version);
+
+	switch (data.m_type)
+	{
+	case DataType_Nil:
+		break;
+	case DataType_Boolean:
+		writer.writeBit(data.m_boolean);
+		break;
+	case DataType_Number:
+		writer.writeObject<float, true>(data.m_number);
+		break;
+	case DataType_String:
+	case DataType_Atom:
 	{
-		writer.writeObject<std::uint32_t, true>(std::uint32_t(data.m_table.size()));
-		// Will currently serialize tables only
-		writer.writeBit(0);
+		const std::string_view v_string = data.getString();
+		LuaData::WriteSize(writer, std::uint32_t(v_string.size()), context.m_version);
+		writer.alignIndex();
 
-		for (const auto& [v_key, v_value] : data.m_table)
+		writer.writeBits(v_string.data(), v_string.size() * 8);
+		break;
+	}
+	case DataType_Table:
+	{
+		const LuaData::TableType& v_table = *data.m_table;
+
+		std::size_t v_size_index;
+		LuaData::WriteTableHeader(writer, v_table, context.m_version, v_size_index);
+
+		const std::size_t v_entries_start = writer.m_dataIndex;
+
+		if (context.m_threadPool != nullptr && v_table.size() >= LuaData::ParallelMinCount)
+		{
+			if (!LuaData::SerializeEntriesParallel(writer, v_table, context)) return false;
+		}
+		else if (!LuaData::SerializeEntries(writer, v_table, 0, v_table.size(), context))
 		{
-			if (!LuaData::SerializeBody(writer, v_key)) return false;
-			if (!LuaData::SerializeBody(writer, v_value)) return false;
+			return false;
 		}
 
+		if (!LuaData::PatchEntriesSize(writer, v_size_index, v_entries_start))
+			return false;
+
 		break;
 	}
 	case DataType_Int32:
-		writer.writeObject<std::int32_t, true>(data.m_int32);
+		LuaData::WriteInteger(writer, data.m_int32, context.m_version);
 		break;
 	case DataType_Int16:
-		writer.writeObject<std::int16_t, true>(data.m_int16);
+		LuaData::WriteInteger(writer, data.m_int16, context.m_version);
 		break;
 	case DataType_Int8:
-		writer.writeObject<std::int8_t, true>(data.m_int8);
+		LuaData::WriteInteger(writer, data.m_int8, context.m_version);
 		break;
 	case DataType_Json:
 	{
-		writer.writeObject<std::uint32_t, true>(std::uint32_t(data.m_string.size()));
+		const std::string_view v_json = data.getString();
+		LuaData::WriteSize(writer, std::uint32_t(v_json.size()), context.m_version);
 		writer.alignIndex();
 
-		writer.writeBits(data.m_string.data(), data.m_string.size() * 8);
+		writer.writeBits(v_json.data(), v_json.size() * 8);
 		break;
 	}
 	case DataType_Userdata:
@@ -433,59 +1211,699 @@ bool LuaData::SerializeBody(BitWriter& writer, const LuaData& data)
 	return true;
 }
 
-bool LuaData::Deserialize(const std::string& b64_data, LuaData& out_data)
+void LuaData::WriteTableHeader(BitWriter& writer, const TableType& table, FormatVersion version, std::size_t& out_size_index)
+{
+	LuaData::WriteSize(writer, std::uint32_t(table.size()), version);
+
+	// Tables that only have the keys 1..n are written as arrays, without any keys
+	const bool v_is_array = table.getHashPart().empty() && !table.getArrayPart().empty();
+	writer.writeBit(v_is_array);
+
+	if (v_is_array)
+		LuaData::WriteSize(writer, 1, version);
+
+	// The size is only known once the entries are written, so it's filled in afterwards
+	const bool v_has_size = version >= FormatVersion_2 && LuaData::HasEntriesSize(table, v_is_array);
+	out_size_index = v_has_size ? writer.m_dataIndex + 1 : 0;
+
+	if (version >= FormatVersion_2)
+		writer.writeBit(v_has_size);
+
+	if (v_has_size)
+		writer.writeObject<std::uint32_t, true>(0);
+}
+
+bool LuaData::PatchEntriesSize(BitWriter& writer, std::size_t size_index, std::size_t entries_start)
+{
+	if (size_index == 0)
+		return true;
+
+	const std::size_t v_entries_sz = writer.m_dataIndex - entries_start;
+	if (v_entries_sz > std::size_t(UINT32_MAX))
+		return false;
+
+	writer.patchValue(size_index, v_entries_sz, 32);
+	return true;
+}
+
+bool LuaData::PushEncodeFrame(BitWriter& writer, const TableType& table, std::vector<EncodeFrame>& stack, const EncodeContext& context)
+{
+	if (stack.size() >= context.m_maxDepth)
+		return false;
+
+	LuaData::WriteType(writer, DataType_Table, context.m_version);
+
+	LuaData::EncodeFrame v_frame{ &table, 0, 0, 0, !table.getHashPart().empty(), false };
+	LuaData::WriteTableHeader(writer, table, context.m_version, v_frame.m_sizeIndex);
+	v_frame.m_entriesStart = writer.m_dataIndex;
+
+	stack.push_back(v_frame);
+	return true;
+}
+
+bool LuaData::SerializeStack(BitWriter& writer, const LuaData& data, const EncodeContext& context)
+{
+	std::vector<LuaData::EncodeFrame>& v_stack = LuaData::GetScratchBuffers().m_encodeStack;
+	v_stack.clear();
+
+	// Writes values other than tables right away, tables only up to their entries
+	const auto v_write_value = [&](const LuaData& value) -> bool
+	{
+		if (value.m_type != DataType_Table) [[likely]]
+			return LuaData::SerializeBody(writer, value, context);
+
+		return LuaData::PushEncodeFrame(writer, *value.m_table, v_stack, context);
+	};
+
+	if (!v_write_value(data))
+		return false;
+
+	while (!v_stack.empty())
+	{
+		const std::size_t v_depth = v_stack.size();
+		LuaData::EncodeFrame& v_frame = v_stack.back();
+		const LuaData::TableType& v_table = *v_frame.m_table;
+		const std::size_t v_array_sz = v_table.getArrayPart().size();
+
+		// Arrays are written without their keys, everything up to the next table in one go
+		if (!v_frame.m_hasKeys)
+		{
+			const std::pmr::vector<LuaData>& v_array = v_table.getArrayPart();
+			while (v_frame.m_position < v_array_sz && v_array[v_frame.m_position].m_type != DataType_Table)
+				if (!LuaData::SerializeBody(writer, v_array[v_frame.m_position++], context)) return false;
+		}
+
+		// Entries come in the order of the table iterator, just like in SerializeEntries. Writing a
+		// table pushes its frame, which invalidates v_frame, so the loop stops at the first one
+		while (v_stack.size() == v_depth && v_frame.m_position < v_table.size())
+		{
+			if (v_frame.m_position < v_array_sz)
+			{
+				// The keys of the array part are never tables
+				if (v_frame.m_hasKeys && !LuaData::SerializeBody(writer, LuaData(std::int32_t(v_frame.m_position + 1)), context))
+					return false;
+
+				if (!v_write_value(v_table.getArrayPart()[v_frame.m_position++]))
+					return false;
+
+				continue;
+			}
+
+			const auto& v_entry = v_table.getHashPart()[v_frame.m_position - v_array_sz];
+			if (!v_frame.m_isKeyWritten)
+			{
+				v_frame.m_isKeyWritten = true;
+				if (!v_write_value(v_entry.first))
+					return false;
+
+				continue;
+			}
+
+			v_frame.m_isKeyWritten = false;
+			v_frame.m_position++;
+			if (!v_write_value(v_entry.second))
+				return false;
+		}
+
+		if (v_stack.size() != v_depth)
+			continue;
+
+		if (!LuaData::PatchEntriesSize(writer, v_frame.m_sizeIndex, v_frame.m_entriesStart))
+			return false;
+
+		v_stack.pop_back();
+	}
+
+	return true;
+}
+
+bool LuaData::SerializeEntries(BitWriter& writer, const TableType& table, std::size_t first, std::size_t last, const EncodeContext& context)
+{
+	// Arrays are written without their keys
+	if (table.getHashPart().empty())
+	{
+		for (std::size_t a = first; a < last; a++)
+			if (!LuaData::SerializeBody(writer, table.getArrayPart()[a], context)) return false;
+
+		return true;
+	}
+
+	for (auto v_iter = TableType::const_iterator(&table, first); v_iter != TableType::const_iterator(&table, last); ++v_iter)
+	{
+		const auto [v_key, v_value] = *v_iter;
+
+		if (!LuaData::SerializeBody(writer, v_key, context)) return false;
+		if (!LuaData::SerializeBody(writer, v_value, context)) return false;
+	}
+
+	return true;
+}
+
+bool LuaData::SerializeEntriesParallel(BitWriter& writer, const TableType& table, const EncodeContext& context)
+{
+	LuaThreadPool& v_pool = *context.m_threadPool;
+
+	const std::size_t v_item_count = table.size();
+	const std::size_t v_chunk_count = std::max<std::size_t>(1, std::min<std::size_t>(
+		(v_pool.getThreadCount() + 1) * LuaData::ParallelChunksPerThread,
+		v_item_count / LuaData::ParallelMinChunkSize));
+	const std::size_t v_chunk_size = (v_item_count + v_chunk_count - 1) / v_chunk_count;
+
+	struct Chunk
+	{
+		std::size_t m_first;
+		std::size_t m_last;
+		// Bit offset the chunk was written at, the bits in front of it are zero
+		std::size_t m_startPhase;
+		BitWriter m_writer;
+		bool m_success;
+	};
+
+	std::vector<Chunk> v_chunks(v_chunk_count);
+	for (std::size_t a = 0; a < v_chunk_count; a++)
+	{
+		v_chunks[a].m_first = std::min(a * v_chunk_size, v_item_count);
+		v_chunks[a].m_last = std::min(v_chunks[a].m_first + v_chunk_size, v_item_count);
+	}
+
+	const auto v_write_chunk = [&table, &context](Chunk& v_chunk, std::size_t v_phase) {
+		v_chunk.m_writer = BitWriter();
+		v_chunk.m_startPhase = v_phase;
+
+		// An empty byte lets the writer start in the middle of it, just like after flush()
+		if (v_phase != 0)
+		{
+			v_chunk.m_writer.m_data.push_back(0);
+			v_chunk.m_writer.m_dataIndex = v_phase;
+		}
+
+		v_chunk.m_success = LuaData::SerializeEntries(v_chunk.m_writer, table, v_chunk.m_first, v_chunk.m_last, context);
+		v_chunk.m_writer.flush();
+	};
+
+	// Where a chunk starts within its first byte is only known once the chunks in front of it are
+	// written, so all but the first one are written as if they started on a byte boundary
+	LuaThreadPool::TaskGroup v_group;
+	for (std::size_t a = 0; a < v_chunk_count; a++)
+	{
+		const std::size_t v_phase = (a == 0) ? (writer.m_dataIndex & 7) : 0;
+		v_pool.run(v_group, [&v_write_chunk, &v_chunk = v_chunks[a], v_phase]() { v_write_chunk(v_chunk, v_phase); });
+	}
+
+	v_pool.wait(v_group);
+
+	// Chunks without aligned values can be shifted to any position. The ones with strings have to
+	// be written again at their real position, which doesn't change the position of the next chunk
+	std::size_t v_phase = writer.m_dataIndex & 7;
+	for (Chunk& v_chunk : v_chunks)
+	{
+		if (!v_chunk.m_success)
+			return false;
+
+		const BitWriter& v_chunk_writer = v_chunk.m_writer;
+		if (v_chunk_writer.m_alignCount == 0)
+		{
+			v_phase = (v_phase + v_chunk_writer.m_dataIndex - v_chunk.m_startPhase) & 7;
+			continue;
+		}
+
+		const std::size_t v_end_phase = v_chunk_writer.m_dataIndex & 7;
+		if (v_chunk.m_startPhase != v_phase)
+			v_pool.run(v_group, [&v_write_chunk, &v_chunk, v_phase]() { v_write_chunk(v_chunk, v_phase); });
+
+		v_phase = v_end_phase;
+	}
+
+	v_pool.wait(v_group);
+
+	for (const Chunk& v_chunk : v_chunks)
+	{
+		if (!v_chunk.m_success)
+			return false;
+
+		const BitWriter& v_chunk_writer = v_chunk.m_writer;
+		writer.appendBits(v_chunk_writer.m_data.data(), v_chunk.m_startPhase, v_chunk_writer.m_dataIndex - v_chunk.m_startPhase);
+	}
+
+	return true;
+}
+
+bool LuaData::Deserialize(const std::string& b64_data, LuaData& out_data, std::pmr::memory_resource* resource, LuaAtomPool* atom_pool,
+	LuaThreadPool* thread_pool)
+{
+	// The compressed buffer isn't used by the binary Deserialize, so the blob is decoded into it
+	std::vector<std::uint8_t>& v_compressed = LuaData::GetScratchBuffers().m_compressed;
+	if (!LuaBase64::Decode(b64_data, v_compressed))
+	{
+		std::cout << "Invalid base64 data\n";
+		return false;
+	}
+
+	return LuaData::Deserialize(std::as_bytes(std::span(v_compressed)), out_data, true, resource, atom_pool, thread_pool);
+}
+
+bool LuaData::Serialize(const LuaData& data, std::string& out_b64_data, FormatVersion version, LuaThreadPool* thread_pool)
+{
+	std::vector<std::uint8_t>& v_compressed = LuaData::GetScratchBuffers().m_compressed;
+	if (!LuaData::Serialize(data, v_compressed, true, version, thread_pool))
+		return false;
+
+	LuaBase64::Encode(v_compressed, out_b64_data);
+	return true;
+}
+
+bool LuaData::Deserialize(std::span<const std::byte> data, LuaData& out_data, bool is_compressed,
+	std::pmr::memory_resource* resource, LuaAtomPool* atom_pool, LuaThreadPool* thread_pool)
 {
-	static char v_decompressed_data[0x8000];
+	if (is_compressed)
+		return LuaData::Deserialize(data, out_data, LuaData::GetScratchBuffers().m_compressor, resource, atom_pool, thread_pool);
 
-	const std::string v_decoded_data = base64_decode(b64_data, false);
-	const int v_decomp_sz = LZ4_decompress_safe(
-		reinterpret_cast<const char*>(v_decoded_data.data()),
-		v_decompressed_data,
-		int(v_decoded_data.size()),
-		sizeof(v_decompressed_data));
+	std::mutex v_atom_mutex;
+	LuaData::DecodeContext v_context{ resource, atom_pool, FormatVersion_1, thread_pool,
+		(thread_pool != nullptr) ? &v_atom_mutex : nullptr };
 
-	if (v_decomp_sz <= 0)
+	return LuaData::DeserializeBlob(data, out_data, nullptr, v_context);
+}
+
+bool LuaData::Deserialize(std::span<const std::byte> data, LuaData& out_data, const LuaCompressor& compressor,
+	std::pmr::memory_resource* resource, LuaAtomPool* atom_pool, LuaThreadPool* thread_pool)
+{
+	std::mutex v_atom_mutex;
+	LuaData::DecodeContext v_context{ resource, atom_pool, FormatVersion_1, thread_pool,
+		(thread_pool != nullptr) ? &v_atom_mutex : nullptr };
+
+	return LuaData::DeserializeBlob(data, out_data, &compressor, v_context);
+}
+
+bool LuaData::DeserializeIterative(std::span<const std::byte> data, LuaData& out_data, bool is_compressed,
+	std::size_t max_depth, std::pmr::memory_resource* resource, LuaAtomPool* atom_pool)
+{
+	LuaData::DecodeContext v_context{ resource, atom_pool, FormatVersion_1 };
+	v_context.m_isIterative = true;
+	v_context.m_maxDepth = max_depth;
+
+	const LuaCompressor* v_compressor = is_compressed ? &LuaData::GetScratchBuffers().m_compressor : nullptr;
+	return LuaData::DeserializeBlob(data, out_data, v_compressor, v_context);
+}
+
+bool LuaData::DeserializeBlob(std::span<const std::byte> data, LuaData& out_data, const LuaCompressor* compressor,
+	DecodeContext& context)
+{
+	if (compressor != nullptr && !LuaData::IsUncompressed(data))
 	{
-		std::cout << "Failed to decompress the data\n";
+		std::vector<std::uint8_t>& v_decompressed = LuaData::GetScratchBuffers().m_decompressed;
+
+		std::size_t v_decomp_sz;
+		if (!compressor->decompress(data, v_decompressed, v_decomp_sz, LuaData::MaxDecompressedSize))
+		{
+			std::cout << "Failed to decompress the data\n";
+			return false;
+		}
+
+		data = std::as_bytes(std::span(v_decompressed.data(), v_decomp_sz));
+	}
+
+	BitReader v_stream(data.data(), data.size());
+	if (!LuaData::DeserializeHeader(v_stream, context.m_version))
+		return false;
+
+	return context.m_isIterative
+		? LuaData::DeserializeStack(v_stream, out_data, context)
+		: LuaData::DeserializeInternal(v_stream, out_data, context);
+}
+
+bool LuaData::Validate(std::span<const std::byte> data, bool is_compressed, const ValidateLimits& limits,
+	ValidateResult& out_result)
+{
+	if (is_compressed)
+		return LuaData::Validate(data, LuaData::GetScratchBuffers().m_compressor, limits, out_result);
+
+	out_result = ValidateResult();
+	out_result.m_dataSize = data.size();
+
+	if (data.size() > limits.m_maxDecompressedSize)
+		return false;
+
+	BitReader v_stream(data.data(), data.size());
+	if (!LuaData::DeserializeHeader(v_stream, out_result.m_version))
+		return false;
+
+	return LuaData::ValidateBody(v_stream, limits, out_result);
+}
+
+bool LuaData::Validate(std::span<const std::byte> data, const LuaCompressor& compressor, const ValidateLimits& limits,
+	ValidateResult& out_result)
+{
+	if (LuaData::IsUncompressed(data))
+		return LuaData::Validate(data, false, limits, out_result);
+
+	std::vector<std::uint8_t>& v_decompressed = LuaData::GetScratchBuffers().m_decompressed;
+
+	// The buffer stops growing at the limit, so a decompression bomb fails before it allocates much
+	std::size_t v_decomp_sz;
+	if (!compressor.decompress(data, v_decompressed, v_decomp_sz, std::min(limits.m_maxDecompressedSize, LuaData::MaxDecompressedSize)))
+	{
+		out_result = ValidateResult();
 		return false;
 	}
 
-	BitReader v_stream(v_decompressed_data, std::size_t(v_decomp_sz));
-	if (!LuaData::DeserializeHeader(v_stream))
+	return LuaData::Validate(std::as_bytes(std::span(v_decompressed.data(), v_decomp_sz)), false, limits, out_result);
+}
+
+bool LuaData::Serialize(const LuaData& data, std::vector<std::uint8_t>& out_data, bool compress, FormatVersion version,
+	LuaThreadPool* thread_pool)
+{
+	// The compressor of this thread keeps its LZ4 state between calls
+	LuaCompressor* v_compressor = compress ? &LuaData::GetScratchBuffers().m_compressor : nullptr;
+	return LuaData::SerializeBlob(data, out_data, v_compressor, CompressionOptions(), LuaData::EncodeContext{ version, thread_pool });
+}
+
+bool LuaData::SerializeIterative(const LuaData& data, std::vector<std::uint8_t>& out_data, bool compress,
+	FormatVersion version, std::size_t max_depth)
+{
+	LuaData::EncodeContext v_context{ version };
+	v_context.m_isIterative = true;
+	v_context.m_maxDepth = max_depth;
+
+	LuaCompressor* v_compressor = compress ? &LuaData::GetScratchBuffers().m_compressor : nullptr;
+	return LuaData::SerializeBlob(data, out_data, v_compressor, CompressionOptions(), v_context);
+}
+
+bool LuaData::Serialize(const LuaData& data, std::vector<std::uint8_t>& out_data, const CompressionOptions& options,
+	FormatVersion version, LuaThreadPool* thread_pool)
+{
+	return LuaData::Serialize(data, out_data, LuaData::GetScratchBuffers().m_compressor, options, version, thread_pool);
+}
+
+bool LuaData::Serialize(const LuaData& data, std::vector<std::uint8_t>& out_data, LuaCompressor& compressor,
+	const CompressionOptions& options, FormatVersion version, LuaThreadPool* thread_pool)
+{
+	return LuaData::SerializeBlob(data, out_data, &compressor, options, LuaData::EncodeContext{ version, thread_pool });
+}
+
+bool LuaData::SerializeBlob(const LuaData& data, std::vector<std::uint8_t>& out_data, LuaCompressor* compressor,
+	const CompressionOptions& options, const EncodeContext& context)
+{
+	// Uncompressed data is written straight into the output buffer, otherwise the body buffer
+	// of the previous call on this thread is reused
+	std::vector<std::uint8_t>& v_body = (compressor != nullptr) ? LuaData::GetScratchBuffers().m_body : out_data;
+
+	BitWriter v_writer;
+	v_writer.m_data.swap(v_body);
+	v_writer.m_data.clear();
+
+	const bool v_success = LuaData::SerializeToWriter(v_writer, data, context);
+
+	v_body.swap(v_writer.m_data);
+	if (!v_success || compressor == nullptr)
+		return v_success;
+
+	out_data.clear();
+	return compressor->compress(v_body, out_data, options);
+}
+
+void LuaData::BuildDictionary(std::span<const LuaData> samples, std::vector<std::uint8_t>& out_dictionary, FormatVersion version)
+{
+	out_dictionary.clear();
+
+	// The serialized samples contain the keys, type tags and headers exactly the way they show up in
+	// real blobs. Only the last samples fit when there are too many of them
+	std::vector<std::uint8_t> v_sample;
+	for (const LuaData& v_data : samples)
+		if (LuaData::Serialize(v_data, v_sample, false, version))
+			out_dictionary.insert(out_dictionary.end(), v_sample.begin(), v_sample.end());
+
+	if (out_dictionary.size() > LuaCompressor::MaxDictionarySize)
+		out_dictionary.erase(out_dictionary.begin(), out_dictionary.end() - std::ptrdiff_t(LuaCompressor::MaxDictionarySize));
+}
+
+bool LuaData::SerializeStream(const LuaData& data, std::vector<std::uint8_t>& out_data, FormatVersion version,
+	LuaThreadPool* thread_pool)
+{
+	std::vector<std::uint8_t>& v_body = LuaData::GetScratchBuffers().m_body;
+
+	BitWriter v_writer;
+	v_writer.m_data.swap(v_body);
+	v_writer.m_data.clear();
+
+	const bool v_success = LuaData::SerializeToWriter(v_writer, data, LuaData::EncodeContext{ version, thread_pool });
+
+	v_body.swap(v_writer.m_data);
+	if (!v_success)
 		return false;
 
-	return LuaData::DeserializeInternal(v_stream, out_data);
+	// The body stays in one buffer, so every block can reference the blocks before it
+	std::unique_ptr<LZ4_stream_t, int(*)(LZ4_stream_t*)> v_stream(LZ4_createStream(), LZ4_freeStream);
+	if (!v_stream)
+		return false;
+
+	const int v_max_block_sz = LZ4_compressBound(int(LuaData::StreamBlockSize));
+	out_data.clear();
+
+	for (std::size_t v_offset = 0; v_offset < v_body.size(); v_offset += LuaData::StreamBlockSize)
+	{
+		const std::size_t v_block_sz = std::min(LuaData::StreamBlockSize, v_body.size() - v_offset);
+		const std::size_t v_out_offset = out_data.size();
+
+		out_data.resize(v_out_offset + 4 + std::size_t(v_max_block_sz));
+
+		const int v_compressed_sz = LZ4_compress_fast_continue(
+			v_stream.get(),
+			reinterpret_cast<const char*>(v_body.data() + v_offset),
+			reinterpret_cast<char*>(out_data.data() + v_out_offset + 4),
+			int(v_block_sz),
+			v_max_block_sz,
+			1);
+
+		if (v_compressed_sz <= 0)
+			return false;
+
+		std::uint8_t* v_size_ptr = out_data.data() + v_out_offset;
+		v_size_ptr[0] = std::uint8_t(v_compressed_sz >> 24);
+		v_size_ptr[1] = std::uint8_t(v_compressed_sz >> 16);
+		v_size_ptr[2] = std::uint8_t(v_compressed_sz >> 8);
+		v_size_ptr[3] = std::uint8_t(v_compressed_sz);
+
+		out_data.resize(v_out_offset + 4 + std::size_t(v_compressed_sz));
+	}
+
+	return true;
+}
+
+bool LuaData::SerializeBatch(std::span<const LuaData> data, LuaBlobBatch& out_batch, bool compress, FormatVersion version,
+	LuaThreadPool* thread_pool)
+{
+	out_batch.clear();
+	out_batch.m_offsets.reserve(data.size() + 1);
+	out_batch.m_offsets.push_back(0);
+
+	const std::size_t v_chunk_count = (thread_pool != nullptr)
+		? std::min((thread_pool->getThreadCount() + 1) * LuaData::ParallelChunksPerThread, data.size() / LuaData::BatchMinChunkSize)
+		: 0;
+
+	if (v_chunk_count < 2)
+		return LuaData::SerializeBatchRange(data, out_batch, compress, version);
+
+	const std::size_t v_chunk_size = (data.size() + v_chunk_count - 1) / v_chunk_count;
+
+	struct Chunk
+	{
+		LuaBlobBatch m_batch;
+		bool m_success;
+	};
+
+	std::vector<Chunk> v_chunks(v_chunk_count);
+
+	LuaThreadPool::TaskGroup v_group;
+	for (std::size_t a = 0; a < v_chunk_count; a++)
+	{
+		const std::size_t v_first = std::min(a * v_chunk_size, data.size());
+		const std::span<const LuaData> v_chunk_data = data.subspan(v_first, std::min(v_chunk_size, data.size() - v_first));
+
+		thread_pool->run(v_group, [&v_chunk = v_chunks[a], v_chunk_data, compress, version]() {
+			v_chunk.m_batch.m_offsets.push_back(0);
+			v_chunk.m_success = LuaData::SerializeBatchRange(v_chunk_data, v_chunk.m_batch, compress, version);
+		});
+	}
+
+	thread_pool->wait(v_group);
+
+	for (const Chunk& v_chunk : v_chunks)
+	{
+		if (!v_chunk.m_success)
+			return false;
+
+		const std::size_t v_base = out_batch.m_data.size();
+		out_batch.m_data.insert(out_batch.m_data.end(), v_chunk.m_batch.m_data.begin(), v_chunk.m_batch.m_data.end());
+
+		for (std::size_t a = 1; a < v_chunk.m_batch.m_offsets.size(); a++)
+			out_batch.m_offsets.push_back(v_base + v_chunk.m_batch.m_offsets[a]);
+	}
+
+	return true;
 }
 
-bool LuaData::Serialize(const LuaData& data, std::string& out_b64_data)
+bool LuaData::SerializeBatchRange(std::span<const LuaData> data, LuaBlobBatch& out_batch, bool compress, FormatVersion version)
 {
+	const LuaData::EncodeContext v_context{ version };
+
+	if (!compress)
+	{
+		// The blobs are written straight into the batch, each one starting on a fresh byte
+		BitWriter v_writer;
+		v_writer.m_data.swap(out_batch.m_data);
+		v_writer.m_dataIndex = v_writer.m_data.size() * 8;
+
+		bool v_success = true;
+		for (const LuaData& v_data : data)
+		{
+			v_success = LuaData::SerializeToWriter(v_writer, v_data, v_context);
+			if (!v_success)
+				break;
+
+			// The padding of the last byte belongs to this blob, the next one starts after it
+			v_writer.m_dataIndex = v_writer.m_data.size() * 8;
+			out_batch.m_offsets.push_back(v_writer.m_data.size());
+		}
+
+		out_batch.m_data.swap(v_writer.m_data);
+		return v_success;
+	}
+
+	LuaCompressor& v_compressor = LuaData::GetScratchBuffers().m_compressor;
+
 	BitWriter v_writer;
+	v_writer.m_data.swap(LuaData::GetScratchBuffers().m_body);
+
+	bool v_success = true;
+	for (const LuaData& v_data : data)
+	{
+		v_writer.m_data.clear();
+		v_writer.m_dataIndex = 0;
+
+		v_success = LuaData::SerializeToWriter(v_writer, v_data, v_context)
+			&& v_compressor.compress(v_writer.m_data, out_batch.m_data);
+
+		if (!v_success)
+			break;
+
+		out_batch.m_offsets.push_back(out_batch.m_data.size());
+	}
+
+	v_writer.m_data.swap(LuaData::GetScratchBuffers().m_body);
+	return v_success;
+}
+
+bool LuaData::DeserializeBatch(std::span<const std::span<const std::byte>> blobs, std::vector<LuaData>& out_data, bool is_compressed,
+	std::pmr::memory_resource* resource, LuaThreadPool* thread_pool)
+{
+	out_data.clear();
+	out_data.resize(blobs.size());
+
+	const std::size_t v_chunk_count = (thread_pool != nullptr)
+		? std::min((thread_pool->getThreadCount() + 1) * LuaData::ParallelChunksPerThread, blobs.size() / LuaData::BatchMinChunkSize)
+		: 0;
+
+	// Every thread decompresses into its own scratch buffer, which is reused for all of its blobs
+	if (v_chunk_count < 2)
+	{
+		for (std::size_t a = 0; a < blobs.size(); a++)
+			if (!LuaData::Deserialize(blobs[a], out_data[a], is_compressed, resource)) return false;
+
+		return true;
+	}
+
+	const std::size_t v_chunk_size = (blobs.size() + v_chunk_count - 1) / v_chunk_count;
+	std::atomic<bool> v_success = true;
+
+	LuaThreadPool::TaskGroup v_group;
+	for (std::size_t v_first = 0; v_first < blobs.size(); v_first += v_chunk_size)
+	{
+		const std::size_t v_last = std::min(v_first + v_chunk_size, blobs.size());
+
+		thread_pool->run(v_group, [&blobs, &out_data, &v_success, v_first, v_last, is_compressed, resource]() {
+			for (std::size_t a = v_first; a < v_last && v_success.load(std::memory_order_relaxed); a++)
+				if (!LuaData::Deserialize(blobs[a], out_data[a], is_compressed, resource)) v_success = false;
+		});
+	}
+
+	thread_pool->wait(v_group);
+	return v_success;
+}
 
+bool LuaData::DeserializeBatch(const LuaBlobBatch& batch, std::vector<LuaData>& out_data, bool is_compressed,
+	std::pmr::memory_resource* resource, LuaThreadPool* thread_pool)
+{
+	std::vector<std::span<const std::byte>> v_blobs;
+	v_blobs.reserve(batch.size());
+
+	for (std::size_t a = 0; a < batch.size(); a++)
+		v_blobs.push_back(batch.getBlob(a));
+
+	return LuaData::DeserializeBatch(v_blobs, out_data, is_compressed, resource, thread_pool);
+}
+
+bool LuaData::IsUncompressed(std::span<const std::byte> data)
+{
+	return data.size() >= 3
+		&& data[0] == std::byte('L')
+		&& data[1] == std::byte('U')
+		&& data[2] == std::byte('A');
+}
+
+bool LuaData::Decompress(std::span<const std::byte> data, std::vector<std::uint8_t>& out_data, std::size_t& out_size)
+{
+	if (LuaData::IsUncompressed(data))
+	{
+		const std::uint8_t* v_bytes = reinterpret_cast<const std::uint8_t*>(data.data());
+		out_data.assign(v_bytes, v_bytes + data.size());
+		out_size = data.size();
+		return true;
+	}
+
+	return LuaData::GetScratchBuffers().m_compressor.decompress(data, out_data, out_size, LuaData::MaxDecompressedSize);
+}
+
+bool LuaData::SerializeToWriter(BitWriter& writer, const LuaData& data, const EncodeContext& context)
+{
 	// Write the secret
 	const char v_secret[] = { 'L', 'U', 'A' };
-	v_writer.writeBits(v_secret, sizeof(v_secret) * 8);
+	writer.writeBits(v_secret, sizeof(v_secret) * 8);
 	// Write version
-	v_writer.writeObject<std::uint32_t, true>(1);
+	writer.writeObject<std::uint32_t, true>(context.m_version);
 	// Write the actual data
-	if (!LuaData::SerializeBody(v_writer, data))
+	const bool v_success = context.m_isIterative
+		? LuaData::SerializeStack(writer, data, context)
+		: LuaData::SerializeBody(writer, data, context);
+
+	if (!v_success)
 		return false;
 
-	// Do the conversion here
-	static char v_compressed_data[0x8000];
+	writer.flush();
+	return true;
+}
+
+bool LuaData::HasEntriesSize(const TableType& table, bool is_array)
+{
+	if (table.size() >= LuaData::EntriesSizeMinCount)
+		return true;
 
-	const int v_compressed_sz = LZ4_compress_default(
-		reinterpret_cast<const char*>(v_writer.m_data.data()),
-		v_compressed_data,
-		int(v_writer.m_data.size()),
-		sizeof(v_compressed_data));
+	// Small tables are worth skipping when they contain other tables
+	if (is_array)
+		return std::any_of(table.getArrayPart().begin(), table.getArrayPart().end(),
+			[](const LuaData& v_value) { return v_value.m_type == DataType_Table; });
 
-	if (v_compressed_sz <= 0)
-		return false;
+	for (const auto& [v_key, v_value] : table)
+		if (v_key.m_type == DataType_Table || v_value.m_type == DataType_Table)
+			return true;
 
-	out_b64_data = base64_encode(
-		reinterpret_cast<std::uint8_t*>(v_compressed_data),
-		std::size_t(v_compressed_sz),
-		false);
+	return false;
+}
 
-	return true;
-}
\ No newline at end of file
+LuaData::ScratchBuffers& LuaData::GetScratchBuffers()
+{
+	// Every thread gets its own buffers, so serialization can run in parallel
+	// without any locks while still reusing the memory between calls
+	thread_local LuaData::ScratchBuffers v_scratch;
+	return v_scratch;
+}
@@ -0,0 +1,321 @@
+#include "LuaDataView.hpp"
+
+#include <algorithm>
+#include <functional>
+
+LuaDataView::LuaDataView()
+	: m_type(DataType_None),
+	m_int32(0),
+	m_string(),
+	m_header{ 0, 0, false, false, 0 },
+	m_reader(nullptr, 0),
+	m_valueIndex(0),
+	m_version(FormatVersion_1) {}
+
+bool LuaDataView::Open(std::span<const std::byte> data, LuaDataView& out_view)
+{
+	BitReader v_reader(data.data(), data.size());
+
+	FormatVersion v_version;
+	if (!LuaData::DeserializeHeader(v_reader, v_version))
+		return false;
+
+	return LuaDataView::ReadView(v_reader, v_version, out_view);
+}
+
+bool LuaDataView::OpenCompressed(std::span<const std::byte> data, std::vector<std::uint8_t>& out_buffer, LuaDataView& out_view)
+{
+	std::size_t v_decomp_sz;
+	if (!LuaData::Decompress(data, out_buffer, v_decomp_sz))
+		return false;
+
+	return LuaDataView::Open(std::as_bytes(std::span(out_buffer.data(), v_decomp_sz)), out_view);
+}
+
+bool LuaDataView::getBoolean(bool& out_value) const
+{
+	if (m_type != DataType_Boolean)
+		return false;
+
+	out_value = m_boolean;
+	return true;
+}
+
+bool LuaDataView::getNumber(float& out_value) const
+{
+	if (m_type != DataType_Number)
+		return false;
+
+	out_value = m_number;
+	return true;
+}
+
+bool LuaDataView::getInteger(std::int32_t& out_value) const
+{
+	switch (m_type)
+	{
+	case DataType_Int32:
+		out_value = m_int32;
+		return true;
+	case DataType_Int16:
+		out_value = std::int32_t(m_int16);
+		return true;
+	case DataType_Int8:
+		out_value = std::int32_t(m_int8);
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool LuaDataView::getString(std::string_view& out_value) const
+{
+	if (m_type != DataType_String && m_type != DataType_Json)
+		return false;
+
+	out_value = m_string;
+	return true;
+}
+
+bool LuaDataView::find(std::string_view key, LuaDataView& out_value) const
+{
+	if (!this->isTable() || m_header.m_isArray)
+		return false;
+
+	bool v_found = false;
+	const bool v_success = this->forEach([&](const LuaDataView& v_key, const LuaDataView& v_value) {
+		if (v_key.m_type != DataType_String || v_key.m_string != key)
+			return true;
+
+		out_value = v_value;
+		v_found = true;
+		return false;
+	});
+
+	return v_success && v_found;
+}
+
+bool LuaDataView::find(std::int32_t key, LuaDataView& out_value) const
+{
+	if (!this->isTable())
+		return false;
+
+	if (m_header.m_isArray)
+	{
+		// Items of arrays have consecutive keys, so everything in front of the item can be skipped
+		const std::int64_t v_item_idx = std::int64_t(key) - std::int64_t(m_header.m_itemOffset);
+		if (v_item_idx < 0 || v_item_idx >= std::int64_t(m_header.m_itemCount))
+			return false;
+
+		BitReader v_reader = m_reader;
+		for (std::int64_t a = 0; a < v_item_idx; a++)
+			if (!LuaData::SkipValue(v_reader, m_version)) return false;
+
+		return LuaDataView::ReadView(v_reader, m_version, out_value);
+	}
+
+	bool v_found = false;
+	const bool v_success = this->forEach([&](const LuaDataView& v_key, const LuaDataView& v_value) {
+		if (v_key.m_type != DataType_Int32 || v_key.m_int32 != key)
+			return true;
+
+		out_value = v_value;
+		v_found = true;
+		return false;
+	});
+
+	return v_success && v_found;
+}
+
+bool LuaDataView::decode(LuaData& out_data, std::pmr::memory_resource* resource) const
+{
+	switch (m_type)
+	{
+	case DataType_Nil:
+		out_data = LuaData(nullptr);
+		return true;
+	case DataType_Boolean:
+		out_data = LuaData(m_boolean);
+		return true;
+	case DataType_Number:
+		out_data = LuaData(m_number);
+		return true;
+	case DataType_String:
+		out_data = LuaData(m_string, resource);
+		return true;
+	case DataType_Json:
+		out_data = LuaData(LuaData::JsonType(m_string, resource));
+		return true;
+	case DataType_Int32:
+		out_data = LuaData(m_int32);
+		return true;
+	case DataType_Int16:
+		out_data = LuaData(m_int16);
+		return true;
+	case DataType_Int8:
+		out_data = LuaData(m_int8);
+		return true;
+	case DataType_Table:
+	{
+		BitReader v_reader = m_reader;
+		v_reader.m_dataIndex = m_valueIndex;
+
+		LuaData v_table;
+		if (!LuaData::DeserializeInternal(v_reader, v_table, LuaData::DecodeContext{ resource, nullptr, m_version }))
+			return false;
+
+		out_data = std::move(v_table);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+bool LuaDataView::ReadView(BitReader& reader, FormatVersion version, LuaDataView& out_view)
+{
+	out_view.m_valueIndex = reader.m_dataIndex;
+	out_view.m_version = version;
+
+	DataType v_type = DataType_None;
+	if (!LuaData::ReadType(reader, v_type, version)) return false;
+
+	switch (v_type)
+	{
+	case DataType_Nil:
+		break;
+	case DataType_Boolean:
+		if (!reader.readBit(&out_view.m_boolean)) return false;
+		break;
+	case DataType_Number:
+		if (!reader.readObject<float, true>(&out_view.m_number)) return false;
+		break;
+	case DataType_Int32:
+		if (!LuaData::ReadInteger(reader, out_view.m_int32, version)) return false;
+		break;
+	case DataType_Int16:
+		if (!LuaData::ReadInteger(reader, out_view.m_int16, version)) return false;
+		break;
+	case DataType_Int8:
+		if (!LuaData::ReadInteger(reader, out_view.m_int8, version)) return false;
+		break;
+	case DataType_String:
+	case DataType_Json:
+	{
+		std::uint32_t v_str_sz;
+		if (!LuaData::ReadSize(reader, v_str_sz, version)) return false;
+		reader.alignIndex();
+		if (!reader.isEnoughData(std::size_t(v_str_sz) * 8)) return false;
+
+		// Strings are byte aligned, so they can be used in place
+		out_view.m_string = std::string_view(
+			reinterpret_cast<const char*>(reader.m_dataPtr) + (reader.m_dataIndex >> 3), v_str_sz);
+		reader.m_dataIndex += std::size_t(v_str_sz) * 8;
+		break;
+	}
+	case DataType_Table:
+	{
+		if (!LuaData::ReadTableHeader(reader, out_view.m_header, version)) return false;
+
+		out_view.m_reader = reader;
+		break;
+	}
+	default:
+		return false;
+	}
+
+	out_view.m_type = v_type;
+	return true;
+}
+
+bool LuaDataView::SkipEntries(BitReader& reader, const LuaDataView& view)
+{
+	if (!view.isTable())
+		return true;
+
+	if (view.m_header.m_hasEntriesSize)
+	{
+		if (!reader.isEnoughData(view.m_header.m_entriesSize))
+			return false;
+
+		reader.m_dataIndex += view.m_header.m_entriesSize;
+		return true;
+	}
+
+	const std::uint64_t v_value_count = view.m_header.m_isArray
+		? std::uint64_t(view.m_header.m_itemCount)
+		: std::uint64_t(view.m_header.m_itemCount) * 2;
+
+	for (std::uint64_t a = 0; a < v_value_count; a++)
+		if (!LuaData::SkipValue(reader, view.m_version)) return false;
+
+	return true;
+}
+
+LuaDataView LuaDataView::MakeArrayKey(std::uint32_t key)
+{
+	LuaDataView v_key;
+	v_key.m_type = DataType_Int32;
+	v_key.m_int32 = std::int32_t(key);
+
+	return v_key;
+}
+
+bool LuaViewIndex::build(const LuaDataView& table)
+{
+	m_entries.clear();
+	m_entries.reserve(table.size());
+
+	const bool v_success = table.forEach([this](const LuaDataView& v_key, const LuaDataView& v_value) {
+		if (v_key.m_type == DataType_String)
+			m_entries.push_back(Entry{ std::hash<std::string_view>{}(v_key.m_string), v_key, v_value });
+		else if (v_key.m_type == DataType_Int32)
+			m_entries.push_back(Entry{ std::hash<std::int32_t>{}(v_key.m_int32), v_key, v_value });
+
+		return true;
+	});
+
+	if (!v_success)
+	{
+		m_entries.clear();
+		return false;
+	}
+
+	// Stable, so duplicate keys resolve to the first one just like in LuaData tables
+	std::stable_sort(m_entries.begin(), m_entries.end(),
+		[](const Entry& lhs, const Entry& rhs) { return lhs.m_hash < rhs.m_hash; });
+
+	return true;
+}
+
+bool LuaViewIndex::find(std::string_view key, LuaDataView& out_value) const
+{
+	return this->findEntry(std::hash<std::string_view>{}(key), [key](const LuaDataView& v_key) {
+		return v_key.m_type == DataType_String && v_key.m_string == key;
+	}, out_value);
+}
+
+bool LuaViewIndex::find(std::int32_t key, LuaDataView& out_value) const
+{
+	return this->findEntry(std::hash<std::int32_t>{}(key), [key](const LuaDataView& v_key) {
+		return v_key.m_type == DataType_Int32 && v_key.m_int32 == key;
+	}, out_value);
+}
+
+template<typename TMatch>
+bool LuaViewIndex::findEntry(std::size_t hash, TMatch&& match, LuaDataView& out_value) const
+{
+	auto v_iter = std::lower_bound(m_entries.begin(), m_entries.end(), hash,
+		[](const Entry& v_entry, std::size_t v_hash) { return v_entry.m_hash < v_hash; });
+
+	for (; v_iter != m_entries.end() && v_iter->m_hash == hash; ++v_iter)
+	{
+		if (match(v_iter->m_key))
+		{
+			out_value = v_iter->m_value;
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,52 @@
+#include "LuaDocument.hpp"
+
+LuaDocument::LuaDocument(std::size_t initial_size)
+	: m_initialBlock(new std::byte[initial_size]),
+	m_arena(m_initialBlock.get(), initial_size),
+	m_lockedArena(&m_arena),
+	m_atomPool(&m_lockedArena),
+	m_root(),
+	m_isModified(false) {}
+
+LuaDocument::~LuaDocument()
+{
+	this->releaseTree();
+}
+
+bool LuaDocument::deserialize(const std::string& b64_data, LuaThreadPool* thread_pool)
+{
+	this->clear();
+	return LuaData::Deserialize(b64_data, m_root, this->getDecodeResource(thread_pool), &m_atomPool, thread_pool);
+}
+
+bool LuaDocument::deserialize(std::span<const std::byte> data, bool is_compressed, LuaThreadPool* thread_pool)
+{
+	this->clear();
+	return LuaData::Deserialize(data, m_root, is_compressed, this->getDecodeResource(thread_pool), &m_atomPool, thread_pool);
+}
+
+void LuaDocument::clear()
+{
+	this->releaseTree();
+	m_atomPool.clear();
+	m_arena.release();
+
+	new (&m_root) LuaData();
+	m_isModified = false;
+}
+
+std::pmr::memory_resource* LuaDocument::getDecodeResource(LuaThreadPool* thread_pool)
+{
+	// The arena itself isn't thread safe, but the lock is only paid for when it's needed
+	if (thread_pool != nullptr)
+		return &m_lockedArena;
+
+	return &m_arena;
+}
+
+void LuaDocument::releaseTree()
+{
+	// A decoded tree owns nothing but arena memory, which is released as a whole
+	if (m_isModified)
+		m_root.~LuaData();
+}
@@ -0,0 +1,644 @@
+#include "LuaJson.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <vector>
+#include <bit>
+
+// SSE2 is part of every x64 CPU, so there's nothing to dispatch at runtime
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define LUA_JSON_SSE2 1
+#include <emmintrin.h>
+#else
+#define LUA_JSON_SSE2 0
+#endif
+
+// Characters that end a run of characters inside of a string, which is copied as it is
+static inline bool IsSpecialChar(std::uint8_t chr)
+{
+	return chr == '"' || chr == '\\' || chr < 0x20;
+}
+
+static const char* FindSpecialChar(const char* begin, const char* end)
+{
+#if LUA_JSON_SSE2
+	const __m128i v_quote = _mm_set1_epi8('"');
+	const __m128i v_backslash = _mm_set1_epi8('\\');
+	const __m128i v_control = _mm_set1_epi8(0x1F);
+
+	for (; end - begin >= 16; begin += 16)
+	{
+		const __m128i v_chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+		// There is no unsigned compare, but min(c, 0x1F) == c is the same as c <= 0x1F
+		const __m128i v_special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v_chars, v_quote), _mm_cmpeq_epi8(v_chars, v_backslash)),
+			_mm_cmpeq_epi8(_mm_min_epu8(v_chars, v_control), v_chars));
+
+		const int v_mask = _mm_movemask_epi8(v_special);
+		if (v_mask != 0)
+			return begin + std::countr_zero(unsigned(v_mask));
+	}
+#endif
+
+	for (; begin != end; begin++)
+		if (IsSpecialChar(std::uint8_t(*begin)))
+			return begin;
+
+	return end;
+}
+
+class JsonWriter
+{
+public:
+	JsonWriter(std::string& out_json, const JsonWriteOptions& options)
+		: m_out(out_json), m_options(options) {}
+
+	bool write(const LuaData& data)
+	{
+		switch (data.m_type)
+		{
+		case DataType_Boolean:
+			m_out.append(data.m_boolean ? "true" : "false");
+			return true;
+		case DataType_Number:
+			this->writeNumber(data.m_number, true);
+			return true;
+		case DataType_String:
+		case DataType_Atom:
+			this->writeString(data.getString());
+			return true;
+		case DataType_Table:
+			return this->writeTable(*data.m_table);
+		case DataType_Int32:
+			this->writeInteger(data.m_int32);
+			return true;
+		case DataType_Int16:
+			this->writeInteger(data.m_int16);
+			return true;
+		case DataType_Int8:
+			this->writeInteger(data.m_int8);
+			return true;
+		case DataType_Json:
+			// An empty value would make the whole output invalid
+			if (m_options.m_embedJson && !data.getString().empty())
+				m_out.append(data.getString());
+			else
+				this->writeString(data.getString());
+
+			return true;
+		default:
+			m_out.append("null", 4);
+			return true;
+		}
+	}
+
+private:
+	bool writeTable(const LuaData::TableType& table)
+	{
+		bool add_comma = false;
+
+		if (m_options.m_writeArrays && table.getHashPart().empty() && !table.getArrayPart().empty())
+		{
+			m_out.push_back('[');
+
+			for (const LuaData& v_value : table.getArrayPart())
+			{
+				if (add_comma) m_out.push_back(',');
+				add_comma = true;
+
+				if (!this->write(v_value)) return false;
+			}
+
+			m_out.push_back(']');
+			return true;
+		}
+
+		m_out.push_back('{');
+
+		for (const auto& [v_key, v_value] : table)
+		{
+			if (!v_key.isString())
+			{
+				if (m_options.m_keyMode == JsonKeyMode_Skip) continue;
+				if (m_options.m_keyMode == JsonKeyMode_Fail) return false;
+			}
+
+			if (add_comma) m_out.push_back(',');
+			add_comma = true;
+
+			if (!this->writeKey(v_key)) return false;
+
+			m_out.push_back(':');
+			if (!this->write(v_value)) return false;
+		}
+
+		m_out.push_back('}');
+		return true;
+	}
+
+	bool writeKey(const LuaData& key)
+	{
+		switch (key.m_type)
+		{
+		case DataType_String:
+		case DataType_Atom:
+			this->writeString(key.getString());
+			return true;
+		case DataType_Boolean:
+			m_out.append(key.m_boolean ? "\"true\"" : "\"false\"");
+			return true;
+		case DataType_Number:
+			if (!std::isfinite(key.m_number))
+				return false;
+
+			m_out.push_back('"');
+			this->writeNumber(key.m_number, false);
+			m_out.push_back('"');
+			return true;
+		case DataType_Int32:
+		case DataType_Int16:
+		case DataType_Int8:
+			m_out.push_back('"');
+			this->writeInteger(key.m_type == DataType_Int32 ? key.m_int32 : (key.m_type == DataType_Int16 ? key.m_int16 : key.m_int8));
+			m_out.push_back('"');
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void writeString(std::string_view str)
+	{
+		const char* v_cur = str.data();
+		const char* const v_end = v_cur + str.size();
+
+		m_out.push_back('"');
+
+		for (;;)
+		{
+			const char* v_special = FindSpecialChar(v_cur, v_end);
+			m_out.append(v_cur, v_special);
+
+			if (v_special == v_end)
+				break;
+
+			this->writeEscape(std::uint8_t(*v_special));
+			v_cur = v_special + 1;
+		}
+
+		m_out.push_back('"');
+	}
+
+	void writeEscape(std::uint8_t chr)
+	{
+		switch (chr)
+		{
+		case '"':  m_out.append("\\\"", 2); break;
+		case '\\': m_out.append("\\\\", 2); break;
+		case '\b': m_out.append("\\b", 2); break;
+		case '\f': m_out.append("\\f", 2); break;
+		case '\n': m_out.append("\\n", 2); break;
+		case '\r': m_out.append("\\r", 2); break;
+		case '\t': m_out.append("\\t", 2); break;
+		default:
+		{
+			static const char v_hex_chars[] = "0123456789abcdef";
+			const char v_escape[] = { '\\', 'u', '0', '0', v_hex_chars[chr >> 4], v_hex_chars[chr & 0xF] };
+
+			m_out.append(v_escape, sizeof(v_escape));
+			break;
+		}
+		}
+	}
+
+	// Shortest representation that reads back as the same float
+	void writeNumber(float number, bool keep_fraction)
+	{
+		if (!std::isfinite(number))
+		{
+			m_out.append("null", 4);
+			return;
+		}
+
+		char v_buffer[64];
+		char* v_end = std::to_chars(v_buffer, v_buffer + sizeof(v_buffer), number).ptr;
+		m_out.append(v_buffer, v_end);
+
+		// Whole numbers would be read back as DataType_Int32
+		if (keep_fraction && std::find_if(v_buffer, v_end, [](char chr) { return chr == '.' || chr == 'e'; }) == v_end)
+			m_out.append(".0", 2);
+	}
+
+	void writeInteger(std::int32_t number)
+	{
+		char v_buffer[16];
+		char* v_end = std::to_chars(v_buffer, v_buffer + sizeof(v_buffer), number).ptr;
+		m_out.append(v_buffer, v_end);
+	}
+
+	std::string& m_out;
+	const JsonWriteOptions& m_options;
+};
+
+class JsonParser
+{
+public:
+	JsonParser(std::string_view json, const JsonReadOptions& options, std::pmr::memory_resource* resource)
+		: m_cur(json.data()), m_end(json.data() + json.size()), m_options(options), m_resource(resource) {}
+
+	bool parse(LuaData& out_data)
+	{
+		if (!this->parseValue(0))
+			return false;
+
+		this->skipWhitespace();
+		if (m_cur != m_end)
+			return false;
+
+		out_data = std::move(m_stack.back());
+		return true;
+	}
+
+private:
+	inline void skipWhitespace()
+	{
+		while (m_cur != m_end && (*m_cur == ' ' || *m_cur == '\n' || *m_cur == '\r' || *m_cur == '\t'))
+			m_cur++;
+	}
+
+	// Skips the whitespace in front of the character
+	inline bool consume(char chr)
+	{
+		this->skipWhitespace();
+		if (m_cur == m_end || *m_cur != chr)
+			return false;
+
+		m_cur++;
+		return true;
+	}
+
+	// Pushes the value onto the stack
+	bool parseValue(std::size_t depth)
+	{
+		this->skipWhitespace();
+		if (m_cur == m_end)
+			return false;
+
+		switch (*m_cur)
+		{
+		case '{':
+			return this->parseObject(depth + 1);
+		case '[':
+			return this->parseArray(depth + 1);
+		case '"':
+		{
+			std::string_view v_str;
+			if (!this->parseString(v_str)) return false;
+
+			m_stack.emplace_back(v_str, m_resource);
+			return true;
+		}
+		case 't':
+			return this->parseLiteral("true", true);
+		case 'f':
+			return this->parseLiteral("false", false);
+		case 'n':
+			return this->parseLiteral("null", nullptr);
+		default:
+			return this->parseNumber();
+		}
+	}
+
+	// The values of every open object and array are kept on one stack, which keeps its capacity.
+	// Once the size of a table is known, it's allocated once and the entries are moved in
+	bool parseObject(std::size_t depth)
+	{
+		if (depth > m_options.m_maxDepth)
+			return false;
+
+		m_cur++;
+		const std::size_t v_first = m_stack.size();
+
+		if (!this->consume('}'))
+		{
+			for (;;)
+			{
+				this->skipWhitespace();
+				if (m_cur == m_end || *m_cur != '"')
+					return false;
+
+				// The key has to be built before the value overwrites the scratch string
+				std::string_view v_key_str;
+				if (!this->parseString(v_key_str)) return false;
+
+				this->pushKey(v_key_str);
+				if (!this->consume(':')) return false;
+
+				if (!this->parseValue(depth)) return false;
+
+				if (this->consume(',')) continue;
+				if (this->consume('}')) break;
+
+				return false;
+			}
+		}
+
+		LuaData::TableType v_table(m_resource);
+		v_table.reserve((m_stack.size() - v_first) / 2);
+
+		for (std::size_t a = v_first; a < m_stack.size(); a += 2)
+		{
+			// Later duplicates win, just like in most parsers
+			const auto v_result = v_table.emplace(std::move(m_stack[a]), std::move(m_stack[a + 1]));
+			if (!v_result.second)
+				v_result.first->second = std::move(m_stack[a + 1]);
+		}
+
+		m_stack.resize(v_first);
+		m_stack.emplace_back(std::move(v_table));
+		return true;
+	}
+
+	bool parseArray(std::size_t depth)
+	{
+		if (depth > m_options.m_maxDepth)
+			return false;
+
+		m_cur++;
+		const std::size_t v_first = m_stack.size();
+
+		if (!this->consume(']'))
+		{
+			for (;;)
+			{
+				if (!this->parseValue(depth)) return false;
+
+				if (this->consume(',')) continue;
+				if (this->consume(']')) break;
+
+				return false;
+			}
+		}
+
+		LuaData::TableType v_table(m_resource);
+		v_table.reserveArray(m_stack.size() - v_first);
+
+		for (std::size_t a = v_first; a < m_stack.size(); a++)
+			v_table.appendArray(std::move(m_stack[a]));
+
+		m_stack.resize(v_first);
+		m_stack.emplace_back(std::move(v_table));
+		return true;
+	}
+
+	// Strings without escape sequences are returned in place, the others are unescaped into
+	// the scratch string, which is only valid until the next call
+	bool parseString(std::string_view& out_str)
+	{
+		const char* v_start = ++m_cur;
+		const char* v_special = FindSpecialChar(m_cur, m_end);
+
+		if (v_special != m_end && *v_special == '"')
+		{
+			out_str = std::string_view(v_start, std::size_t(v_special - v_start));
+			m_cur = v_special + 1;
+			return true;
+		}
+
+		m_scratch.assign(v_start, v_special);
+		m_cur = v_special;
+
+		for (;;)
+		{
+			if (m_cur == m_end)
+				return false;
+
+			const char v_chr = *m_cur++;
+			if (v_chr == '"')
+				break;
+
+			// Raw control characters aren't allowed inside of strings
+			if (v_chr != '\\' || !this->parseEscape())
+				return false;
+
+			v_special = FindSpecialChar(m_cur, m_end);
+			m_scratch.append(m_cur, v_special);
+			m_cur = v_special;
+		}
+
+		out_str = m_scratch;
+		return true;
+	}
+
+	bool parseEscape()
+	{
+		if (m_cur == m_end)
+			return false;
+
+		switch (*m_cur++)
+		{
+		case '"':  m_scratch.push_back('"'); return true;
+		case '\\': m_scratch.push_back('\\'); return true;
+		case '/':  m_scratch.push_back('/'); return true;
+		case 'b':  m_scratch.push_back('\b'); return true;
+		case 'f':  m_scratch.push_back('\f'); return true;
+		case 'n':  m_scratch.push_back('\n'); return true;
+		case 'r':  m_scratch.push_back('\r'); return true;
+		case 't':  m_scratch.push_back('\t'); return true;
+		case 'u':
+			break;
+		default:
+			return false;
+		}
+
+		std::uint32_t v_code_point = 0;
+		if (!this->parseHex(v_code_point))
+			return false;
+
+		// Surrogate pairs are combined, lone surrogates are kept just like any other code point
+		if (v_code_point >= 0xD800 && v_code_point < 0xDC00 && m_end - m_cur >= 6 && m_cur[0] == '\\' && m_cur[1] == 'u')
+		{
+			const char* v_pair_start = m_cur;
+			m_cur += 2;
+
+			std::uint32_t v_low = 0;
+			if (this->parseHex(v_low) && v_low >= 0xDC00 && v_low < 0xE000)
+				v_code_point = 0x10000 + ((v_code_point - 0xD800) << 10) + (v_low - 0xDC00);
+			else
+				m_cur = v_pair_start;
+		}
+
+		this->appendUtf8(v_code_point);
+		return true;
+	}
+
+	bool parseHex(std::uint32_t& out_value)
+	{
+		if (m_end - m_cur < 4)
+			return false;
+
+		const std::from_chars_result v_result = std::from_chars(m_cur, m_cur + 4, out_value, 16);
+		if (v_result.ptr != m_cur + 4)
+			return false;
+
+		m_cur += 4;
+		return true;
+	}
+
+	void appendUtf8(std::uint32_t code_point)
+	{
+		if (code_point < 0x80)
+		{
+			m_scratch.push_back(char(code_point));
+		}
+		else if (code_point < 0x800)
+		{
+			m_scratch.push_back(char(0xC0 | (code_point >> 6)));
+			m_scratch.push_back(char(0x80 | (code_point & 0x3F)));
+		}
+		else if (code_point < 0x10000)
+		{
+			m_scratch.push_back(char(0xE0 | (code_point >> 12)));
+			m_scratch.push_back(char(0x80 | ((code_point >> 6) & 0x3F)));
+			m_scratch.push_back(char(0x80 | (code_point & 0x3F)));
+		}
+		else
+		{
+			m_scratch.push_back(char(0xF0 | (code_point >> 18)));
+			m_scratch.push_back(char(0x80 | ((code_point >> 12) & 0x3F)));
+			m_scratch.push_back(char(0x80 | ((code_point >> 6) & 0x3F)));
+			m_scratch.push_back(char(0x80 | (code_point & 0x3F)));
+		}
+	}
+
+	template<typename T>
+	bool parseLiteral(std::string_view literal, T value)
+	{
+		if (std::size_t(m_end - m_cur) < literal.size() || std::string_view(m_cur, literal.size()) != literal)
+			return false;
+
+		m_cur += literal.size();
+		m_stack.emplace_back(value);
+		return true;
+	}
+
+	inline bool skipDigits()
+	{
+		const char* v_start = m_cur;
+		while (m_cur != m_end && *m_cur >= '0' && *m_cur <= '9')
+			m_cur++;
+
+		return m_cur != v_start;
+	}
+
+	bool parseNumber()
+	{
+		// from_chars is more liberal than JSON, so the grammar is checked first
+		const char* v_start = m_cur;
+		bool v_is_integer = true;
+
+		if (*m_cur == '-')
+			m_cur++;
+
+		if (m_cur != m_end && *m_cur == '0')
+			m_cur++;
+		else if (!this->skipDigits())
+			return false;
+
+		if (m_cur != m_end && *m_cur == '.')
+		{
+			m_cur++;
+			v_is_integer = false;
+
+			if (!this->skipDigits()) return false;
+		}
+
+		if (m_cur != m_end && (*m_cur == 'e' || *m_cur == 'E'))
+		{
+			m_cur++;
+			v_is_integer = false;
+
+			if (m_cur != m_end && (*m_cur == '+' || *m_cur == '-'))
+				m_cur++;
+
+			if (!this->skipDigits()) return false;
+		}
+
+		if (v_is_integer)
+		{
+			std::int32_t v_integer;
+			if (std::from_chars(v_start, m_cur, v_integer).ec == std::errc())
+			{
+				m_stack.emplace_back(v_integer);
+				return true;
+			}
+		}
+
+		float v_number;
+		const std::from_chars_result v_result = std::from_chars(v_start, m_cur, v_number);
+		if (v_result.ec == std::errc::result_out_of_range)
+		{
+			// Goes to inf or 0 just like a cast, unless the number doesn't even fit into a double
+			double v_wide_number;
+			if (std::from_chars(v_start, m_cur, v_wide_number).ec != std::errc())
+				return false;
+
+			v_number = float(v_wide_number);
+		}
+		else if (v_result.ec != std::errc())
+		{
+			return false;
+		}
+
+		m_stack.emplace_back(v_number);
+		return true;
+	}
+
+	void pushKey(std::string_view key)
+	{
+		if (m_options.m_parseIntegerKeys && !key.empty())
+		{
+			// Only the way writeInteger prints numbers, so "01" or "-0" stay strings
+			const std::size_t v_digits_start = (key[0] == '-') ? 1 : 0;
+			bool v_is_canonical = key.size() > v_digits_start
+				&& (key[v_digits_start] != '0' || key.size() == 1);
+
+			// Keys that don't fit into std::int32_t stay strings as well
+			std::int32_t v_integer;
+			const char* v_key_end = key.data() + key.size();
+			if (v_is_canonical)
+			{
+				const std::from_chars_result v_result = std::from_chars(key.data(), v_key_end, v_integer);
+				v_is_canonical = v_result.ec == std::errc() && v_result.ptr == v_key_end;
+			}
+
+			if (v_is_canonical)
+			{
+				m_stack.emplace_back(v_integer);
+				return;
+			}
+		}
+
+		m_stack.emplace_back(key, m_resource);
+	}
+
+	const char* m_cur;
+	const char* const m_end;
+	const JsonReadOptions& m_options;
+	std::pmr::memory_resource* m_resource;
+	std::string m_scratch;
+	std::vector<LuaData> m_stack;
+};
+
+bool LuaJson::Write(const LuaData& data, std::string& out_json, const JsonWriteOptions& options)
+{
+	JsonWriter v_writer(out_json, options);
+	return v_writer.write(data);
+}
+
+bool LuaJson::Read(std::string_view json, LuaData& out_data, const JsonReadOptions& options, std::pmr::memory_resource* resource)
+{
+	JsonParser v_parser(json, options, resource);
+	return v_parser.parse(out_data);
+}
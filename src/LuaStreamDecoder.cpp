@@ -0,0 +1,287 @@
+#include "LuaStreamDecoder.hpp"
+
+#include <algorithm>
+
+#include <lz4/lz4.h>
+
+LuaStreamDecoder::LuaStreamDecoder(bool is_compressed)
+	: m_input(),
+	m_inputOffset(0),
+	m_data(),
+	m_reader(nullptr, 0),
+	m_stack(),
+	m_result(),
+	m_status(StreamStatus_NeedMoreData),
+	m_isCompressed(is_compressed),
+	m_headerRead(false),
+	m_version(FormatVersion_1) {}
+
+StreamStatus LuaStreamDecoder::feed(std::span<const std::byte> chunk)
+{
+	if (m_status != StreamStatus_NeedMoreData)
+		return m_status;
+
+	if (m_isCompressed)
+	{
+		m_input.insert(m_input.end(),
+			reinterpret_cast<const std::uint8_t*>(chunk.data()),
+			reinterpret_cast<const std::uint8_t*>(chunk.data() + chunk.size()));
+
+		if (!this->decompressBlocks())
+			return m_status = StreamStatus_Error;
+	}
+	else
+	{
+		m_data.insert(m_data.end(),
+			reinterpret_cast<const std::uint8_t*>(chunk.data()),
+			reinterpret_cast<const std::uint8_t*>(chunk.data() + chunk.size()));
+	}
+
+	m_reader.setData(m_data.data(), m_data.size());
+
+	m_status = this->parse();
+	if (m_status == StreamStatus_NeedMoreData)
+		this->compactData();
+
+	return m_status;
+}
+
+void LuaStreamDecoder::reset()
+{
+	m_input.clear();
+	m_inputOffset = 0;
+	m_data.clear();
+	m_reader = BitReader(nullptr, 0);
+	m_stack.clear();
+	m_result = LuaData();
+	m_status = StreamStatus_NeedMoreData;
+	m_headerRead = false;
+	m_version = FormatVersion_1;
+}
+
+bool LuaStreamDecoder::decompressBlocks()
+{
+	const int v_max_block_sz = LZ4_compressBound(int(LuaData::StreamBlockSize));
+
+	for (;;)
+	{
+		const std::size_t v_available = m_input.size() - m_inputOffset;
+		if (v_available < 4)
+			break;
+
+		const std::uint8_t* v_block = m_input.data() + m_inputOffset;
+		const std::uint32_t v_block_sz = (std::uint32_t(v_block[0]) << 24) | (std::uint32_t(v_block[1]) << 16)
+			| (std::uint32_t(v_block[2]) << 8) | std::uint32_t(v_block[3]);
+
+		if (v_block_sz == 0 || v_block_sz > std::uint32_t(v_max_block_sz))
+			return false;
+
+		if (v_available < 4 + std::size_t(v_block_sz))
+			break;
+
+		// The output of the previous blocks directly precedes the new block, which lets LZ4 use it as the prefix
+		const std::size_t v_old_sz = m_data.size();
+		const std::size_t v_dict_sz = std::min(v_old_sz, LuaStreamDecoder::HistorySize);
+		m_data.resize(v_old_sz + LuaData::StreamBlockSize);
+
+		char* v_dest = reinterpret_cast<char*>(m_data.data() + v_old_sz);
+		const int v_decomp_sz = LZ4_decompress_safe_usingDict(
+			reinterpret_cast<const char*>(v_block + 4),
+			v_dest,
+			int(v_block_sz),
+			int(LuaData::StreamBlockSize),
+			v_dest - v_dict_sz,
+			int(v_dict_sz));
+
+		if (v_decomp_sz <= 0)
+			return false;
+
+		m_data.resize(v_old_sz + std::size_t(v_decomp_sz));
+		m_inputOffset += 4 + std::size_t(v_block_sz);
+	}
+
+	if (m_inputOffset == m_input.size())
+	{
+		m_input.clear();
+		m_inputOffset = 0;
+	}
+	else if (m_inputOffset >= LuaStreamDecoder::CompactThreshold)
+	{
+		m_input.erase(m_input.begin(), m_input.begin() + m_inputOffset);
+		m_inputOffset = 0;
+	}
+
+	return true;
+}
+
+StreamStatus LuaStreamDecoder::parse()
+{
+	if (!m_headerRead)
+	{
+		if (!m_reader.isEnoughData(7 * 8))
+			return StreamStatus_NeedMoreData;
+
+		if (!LuaData::DeserializeHeader(m_reader, m_version))
+			return StreamStatus_Error;
+
+		m_headerRead = true;
+	}
+
+	// The decoded values are handed to the caller, so they don't use any special resource
+	const LuaData::DecodeContext v_context{ std::pmr::get_default_resource(), nullptr, m_version };
+
+	for (;;)
+	{
+		const std::size_t v_value_start = m_reader.m_dataIndex;
+
+		LuaData v_value;
+		LuaData::TableHeader v_header;
+		if (!LuaData::DeserializeValue(m_reader, v_value, v_header, v_context, false))
+		{
+			// Values are only read once they are complete, so resume from the start of this one
+			m_reader.m_dataIndex = v_value_start;
+			return this->isTruncated() ? StreamStatus_NeedMoreData : StreamStatus_Error;
+		}
+
+		if (v_value.m_type == DataType_Table && v_header.m_itemCount > 0)
+		{
+			m_stack.push_back(Frame{ std::move(v_value), LuaData(), v_header, m_reader.m_dataIndex, 0, false });
+			continue;
+		}
+
+		if (v_value.m_type == DataType_Table && v_header.m_hasEntriesSize && v_header.m_entriesSize != 0)
+			return StreamStatus_Error;
+
+		// Add the finished value to its table, which might finish the table as well
+		for (;;)
+		{
+			if (m_stack.empty())
+			{
+				m_result = std::move(v_value);
+				return StreamStatus_Done;
+			}
+
+			Frame& v_frame = m_stack.back();
+			if (v_frame.m_header.m_isArray)
+			{
+				LuaData::InsertArrayItem(*v_frame.m_table.m_table, v_frame.m_header, v_frame.m_itemIdx, std::move(v_value));
+			}
+			else if (!v_frame.m_hasKey)
+			{
+				v_frame.m_key = std::move(v_value);
+				v_frame.m_hasKey = true;
+				break;
+			}
+			else
+			{
+				v_frame.m_table.m_table->emplace(std::move(v_frame.m_key), std::move(v_value));
+				v_frame.m_hasKey = false;
+			}
+
+			if (++v_frame.m_itemIdx < v_frame.m_header.m_itemCount)
+				break;
+
+			// A size that doesn't match the entries means that the blob is corrupted
+			if (v_frame.m_header.m_hasEntriesSize && m_reader.m_dataIndex - v_frame.m_entriesStart != v_frame.m_header.m_entriesSize)
+				return StreamStatus_Error;
+
+			v_value = std::move(v_frame.m_table);
+			m_stack.pop_back();
+		}
+	}
+}
+
+bool LuaStreamDecoder::isTruncated()
+{
+	const std::size_t v_value_start = m_reader.m_dataIndex;
+
+	// Reads of known types can only fail because the rest of the value hasn't arrived yet,
+	// except for the varints of FormatVersion_3, which can be malformed as well
+	DataType v_type = DataType_None;
+	if (!LuaData::ReadType(m_reader, v_type, m_version))
+		return true;
+
+	bool v_is_truncated = v_type >= DataType_Nil && v_type <= DataType_Json;
+	if (v_is_truncated && m_version >= FormatVersion_3)
+		v_is_truncated = this->isVarIntTruncated(v_type);
+
+	m_reader.m_dataIndex = v_value_start;
+
+	return v_is_truncated;
+}
+
+bool LuaStreamDecoder::isVarIntTruncated(DataType type)
+{
+	// A varint that failed to read is only truncated when some of its groups are missing
+	const auto v_is_cut_off = [this](std::size_t var_start) -> bool
+	{
+		m_reader.m_dataIndex = var_start;
+		return !m_reader.isVarUIntComplete();
+	};
+
+	std::size_t v_var_start = m_reader.m_dataIndex;
+	switch (type)
+	{
+	case DataType_String:
+	case DataType_Json:
+	{
+		std::uint32_t v_size;
+		if (!LuaData::ReadSize(m_reader, v_size, m_version)) return v_is_cut_off(v_var_start);
+		break;
+	}
+	case DataType_Table:
+	{
+		std::uint32_t v_count;
+		if (!LuaData::ReadSize(m_reader, v_count, m_version)) return v_is_cut_off(v_var_start);
+
+		bool v_is_array;
+		if (!m_reader.readBit(&v_is_array)) return true;
+
+		v_var_start = m_reader.m_dataIndex;
+		std::uint32_t v_offset;
+		if (v_is_array && !LuaData::ReadSize(m_reader, v_offset, m_version)) return v_is_cut_off(v_var_start);
+		break;
+	}
+	case DataType_Int32:
+	{
+		std::int32_t v_int32;
+		if (!LuaData::ReadInteger(m_reader, v_int32, m_version)) return v_is_cut_off(v_var_start);
+		break;
+	}
+	case DataType_Int16:
+	{
+		std::int16_t v_int16;
+		if (!LuaData::ReadInteger(m_reader, v_int16, m_version)) return v_is_cut_off(v_var_start);
+		break;
+	}
+	case DataType_Int8:
+	{
+		std::int8_t v_int8;
+		if (!LuaData::ReadInteger(m_reader, v_int8, m_version)) return v_is_cut_off(v_var_start);
+		break;
+	}
+	default:
+		break;
+	}
+
+	// The varints are fine, so it's the fixed size part that hasn't arrived yet
+	return true;
+}
+
+void LuaStreamDecoder::compactData()
+{
+	std::size_t v_drop_sz = m_reader.m_dataIndex >> 3;
+	if (m_isCompressed)
+		v_drop_sz = std::min(v_drop_sz, m_data.size() - std::min(m_data.size(), LuaStreamDecoder::HistorySize));
+
+	if (v_drop_sz < LuaStreamDecoder::CompactThreshold)
+		return;
+
+	m_data.erase(m_data.begin(), m_data.begin() + v_drop_sz);
+	m_reader.m_dataIndex -= v_drop_sz * 8;
+
+	// Only differences of the start indices are used, so wrapping around is fine
+	for (Frame& v_frame : m_stack)
+		v_frame.m_entriesStart -= v_drop_sz * 8;
+	m_reader.setData(m_data.data(), m_data.size());
+}
@@ -0,0 +1,149 @@
+#include "LuaThreadPool.hpp"
+
+// Pool and worker index of the calling thread, so tasks that start tasks push them to their own queue
+static thread_local const LuaThreadPool* g_currentPool = nullptr;
+static thread_local std::size_t g_currentWorker = 0;
+
+LuaThreadPool::LuaThreadPool(std::size_t thread_count)
+	: m_queuedCount(0),
+	m_nextQueue(0),
+	m_stop(false)
+{
+	if (thread_count == 0)
+		thread_count = 1;
+
+	m_workers.reserve(thread_count);
+	for (std::size_t a = 0; a < thread_count; a++)
+		m_workers.push_back(std::make_unique<Worker>());
+
+	m_threads.reserve(thread_count);
+	for (std::size_t a = 0; a < thread_count; a++)
+		m_threads.emplace_back(&LuaThreadPool::workerLoop, this, a);
+}
+
+LuaThreadPool::~LuaThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> v_lock(m_sleepMutex);
+		m_stop = true;
+	}
+
+	m_sleepCondition.notify_all();
+
+	for (std::thread& v_thread : m_threads)
+		v_thread.join();
+}
+
+void LuaThreadPool::run(TaskGroup& group, std::function<void()> task)
+{
+	group.m_pending.fetch_add(1, std::memory_order_relaxed);
+
+	std::size_t v_queue_idx = this->getCurrentWorker();
+	if (v_queue_idx == m_workers.size())
+		v_queue_idx = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+
+	{
+		// Counted before it's queued, so the count never drops below the number of queued tasks.
+		// Taking the lock makes sure that a worker can't miss the task right before it goes to sleep
+		std::lock_guard<std::mutex> v_lock(m_sleepMutex);
+		m_queuedCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Worker& v_worker = *m_workers[v_queue_idx];
+	{
+		std::lock_guard<std::mutex> v_lock(v_worker.m_mutex);
+		v_worker.m_tasks.push_back(Task{ std::move(task), &group });
+	}
+
+	m_sleepCondition.notify_one();
+}
+
+void LuaThreadPool::wait(TaskGroup& group)
+{
+	const std::size_t v_worker_idx = this->getCurrentWorker();
+
+	// Only the tasks of the group itself, a task of another caller could overwrite the scratch
+	// buffers of this thread while the caller still uses them
+	while (group.m_pending.load(std::memory_order_acquire) > 0)
+		if (!this->runNextTask(v_worker_idx, &group))
+			std::this_thread::yield();
+}
+
+std::size_t LuaThreadPool::getCurrentWorker() const
+{
+	return (g_currentPool == this) ? g_currentWorker : m_workers.size();
+}
+
+bool LuaThreadPool::runNextTask(std::size_t worker_idx, const TaskGroup* group)
+{
+	const std::size_t v_worker_count = m_workers.size();
+
+	Task v_task;
+	bool v_has_task = false;
+
+	if (worker_idx < v_worker_count)
+	{
+		// The newest task of the own queue is the one whose data is most likely still in the cache
+		Worker& v_worker = *m_workers[worker_idx];
+
+		std::lock_guard<std::mutex> v_lock(v_worker.m_mutex);
+		for (auto v_iter = v_worker.m_tasks.rbegin(); v_iter != v_worker.m_tasks.rend(); ++v_iter)
+		{
+			if (group != nullptr && v_iter->m_group != group)
+				continue;
+
+			v_task = std::move(*v_iter);
+			v_worker.m_tasks.erase(std::next(v_iter).base());
+			v_has_task = true;
+			break;
+		}
+	}
+
+	// Steal the oldest task of another worker, which usually is the biggest piece of work left
+	for (std::size_t a = 1; !v_has_task && a <= v_worker_count; a++)
+	{
+		Worker& v_victim = *m_workers[(worker_idx + a) % v_worker_count];
+
+		std::lock_guard<std::mutex> v_lock(v_victim.m_mutex);
+		for (auto v_iter = v_victim.m_tasks.begin(); v_iter != v_victim.m_tasks.end(); ++v_iter)
+		{
+			if (group != nullptr && v_iter->m_group != group)
+				continue;
+
+			v_task = std::move(*v_iter);
+			v_victim.m_tasks.erase(v_iter);
+			v_has_task = true;
+			break;
+		}
+	}
+
+	if (!v_has_task)
+		return false;
+
+	m_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+
+	v_task.m_func();
+	v_task.m_group->m_pending.fetch_sub(1, std::memory_order_release);
+
+	return true;
+}
+
+void LuaThreadPool::workerLoop(std::size_t worker_idx)
+{
+	g_currentPool = this;
+	g_currentWorker = worker_idx;
+
+	for (;;)
+	{
+		if (this->runNextTask(worker_idx, nullptr))
+			continue;
+
+		std::unique_lock<std::mutex> v_lock(m_sleepMutex);
+		m_sleepCondition.wait(v_lock, [this] {
+			return m_stop || m_queuedCount.load(std::memory_order_relaxed) > 0;
+		});
+
+		if (m_stop)
+			return;
+	}
+}
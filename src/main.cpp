@@ -35,7 +35,7 @@ int main()
 		LuaData v_data;
 		LuaData::Deserialize("8ARMVUEAAAABBQAAAAGAAAAABAAA", v_data);
 
-		v_data.m_table["JsonData"] = LuaData::JsonType("{ \"1\": [ { \"test\": true } ] }");
+		(*v_data.m_table)["JsonData"] = LuaData::JsonType("{ \"1\": [ { \"test\": true } ] }");
 
 		std::string v_b64;
 		LuaData::Serialize(v_data, v_b64);
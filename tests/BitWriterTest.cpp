@@ -0,0 +1,132 @@
+// Checks the bytes BitWriter writes against the ones of the original byte by byte writer, which
+// define the format of the blobs. Every sequence mixes widths, so the writes start at every
+// bit offset and cross the 64 bit words the writer collects the bits in.
+
+#include "BitStream.hpp"
+
+#include <iostream>
+#include <cstdio>
+
+// Source bytes of a write, the bits past bit_count are cleared like the serializer does
+static std::vector<std::uint8_t> MakeBits(std::size_t bit_count, bool align_right, std::uint8_t seed)
+{
+	std::vector<std::uint8_t> v_bytes((bit_count + 7) / 8);
+	for (std::size_t a = 0; a < v_bytes.size(); a++)
+		v_bytes[a] = std::uint8_t(seed + a * 151 + (a >> 2) * 29);
+
+	const std::size_t v_rest_bits = bit_count & 7;
+	if (v_rest_bits != 0)
+		v_bytes.back() &= align_right ? std::uint8_t(0xFF >> (8 - v_rest_bits)) : std::uint8_t(0xFF << (8 - v_rest_bits));
+
+	return v_bytes;
+}
+
+static void WriteBits(BitWriter& writer, std::size_t bit_count, bool align_right, std::uint8_t seed)
+{
+	const std::vector<std::uint8_t> v_bytes = MakeBits(bit_count, align_right, seed);
+	writer.writeBits(v_bytes.data(), bit_count, align_right);
+}
+
+static void WriteWidths(BitWriter& writer)
+{
+	const std::size_t v_widths[] = { 1, 31, 32, 64, 1, 64, 3, 32, 31, 7, 64, 13, 1, 1, 33, 63, 8, 100 };
+
+	std::uint8_t v_seed = 1;
+	for (const std::size_t v_width : v_widths)
+		WriteBits(writer, v_width, false, v_seed++);
+}
+
+static void WriteRightAligned(BitWriter& writer)
+{
+	const std::size_t v_widths[] = { 3, 31, 1, 64, 5, 32, 7, 31, 2, 64, 13 };
+
+	std::uint8_t v_seed = 40;
+	for (const std::size_t v_width : v_widths)
+		WriteBits(writer, v_width, true, v_seed++);
+}
+
+// The same 64 bit write at every offset within a word
+static void WriteWordRuns(BitWriter& writer)
+{
+	for (std::uint8_t a = 0; a < 9; a++)
+	{
+		WriteBits(writer, 64, false, std::uint8_t(100 + a));
+		writer.writeBit(a & 1);
+	}
+}
+
+// The way LuaData writes its values: types, bits, big endian objects and aligned strings
+static void WriteObjects(BitWriter& writer)
+{
+	writer.writeObject<std::uint8_t>(5);
+	writer.writeBit(true);
+	writer.writeObject<std::uint32_t, true>(0x12345678);
+	writer.writeObject<std::int16_t, true>(-2);
+	writer.writeBit(false);
+	writer.writeObject<float, true>(1.5f);
+
+	writer.alignIndex();
+	WriteBits(writer, 8 * 11, false, 200);
+
+	writer.writeObject<std::uint8_t>(4);
+	writer.writeObject<std::uint32_t, true>(3);
+	writer.alignIndex();
+	WriteBits(writer, 24, false, 7);
+	writer.writeBit(true);
+}
+
+struct WriterCase
+{
+	const char* m_name;
+	void (*m_write)(BitWriter&);
+	std::vector<std::uint8_t> m_expected;
+};
+
+int main()
+{
+	// Written by the byte by byte BitWriter the format started with
+	const WriterCase v_cases[] =
+	{
+		{ "Widths", WriteWidths, {
+			0x01, 0x4C, 0x98, 0x63, 0x03, 0x9A, 0x31, 0xC8, 0x04, 0x9B, 0x32, 0xC9, 0x7D, 0x14, 0xAB, 0x42,
+			0x03, 0x4E, 0x9A, 0x65, 0xBF, 0x8B, 0x56, 0xA2, 0x00, 0x89, 0xF3, 0x6C, 0xD0, 0x9A, 0x03, 0x7C,
+			0xE1, 0x42, 0xE8, 0x8E, 0x74, 0x21, 0x06, 0xEC, 0x92, 0x43, 0x28, 0x07, 0xD3, 0x1E, 0xEA, 0x44,
+			0x29, 0xCF, 0xB5, 0x62, 0x48, 0x2D, 0xD3, 0x88, 0x89, 0x54, 0xA0, 0x6B, 0xC5, 0x91, 0x5C, 0xA8,
+			0x02, 0x4D, 0x99, 0x64, 0xB8 } },
+		{ "Right aligned", WriteRightAligned, {
+			0x05, 0x38, 0x0A, 0xFB, 0x85, 0x78, 0x4B, 0x3E, 0x14, 0x87, 0x7A, 0x4D, 0x2C, 0x2D, 0xC4, 0x5B,
+			0xF2, 0x5C, 0x5F, 0x8C, 0xBB, 0xD0, 0x31, 0xC8, 0x5F, 0xF6, 0xAA, 0x41, 0xD8, 0x6F, 0x32, 0x48 } },
+		{ "Word runs", WriteWordRuns, {
+			0x64, 0xFB, 0x92, 0x29, 0xDD, 0x74, 0x0B, 0xA2, 0x32, 0xFE, 0x49, 0x95, 0x6F, 0x3A, 0x86, 0x51,
+			0xD9, 0xBF, 0x65, 0x0A, 0xF7, 0xDD, 0x83, 0x69, 0x0C, 0xFF, 0xD2, 0xA5, 0x9C, 0x0E, 0xE1, 0xD4,
+			0xB6, 0x8F, 0xF9, 0x62, 0xDE, 0x17, 0x80, 0xFA, 0x63, 0x48, 0x04, 0xB9, 0x77, 0x13, 0xC8, 0x85,
+			0x3D, 0xA8, 0x06, 0x60, 0xBF, 0x8D, 0xE8, 0x46, 0xA0, 0xD6, 0x05, 0x32, 0x61, 0xC8, 0xF6, 0x25,
+			0x53, 0x6C, 0x03, 0x9A, 0x31, 0xE5, 0x7C, 0x13, 0xAA, 0x00 } },
+		{ "Objects", WriteObjects, {
+			0x05, 0x89, 0x1A, 0x2B, 0x3C, 0x7F, 0xFF, 0x0F, 0xF0, 0x00, 0x00, 0x00, 0xC8, 0x5F, 0xF6, 0x8D,
+			0x41, 0xD8, 0x6F, 0x06, 0xBA, 0x51, 0xE8, 0x04, 0x00, 0x00, 0x00, 0x03, 0x07, 0x9E, 0x35, 0x80 } },
+	};
+
+	bool v_success = true;
+	for (const WriterCase& v_case : v_cases)
+	{
+		BitWriter v_writer;
+		v_case.m_write(v_writer);
+		v_writer.flush();
+
+		if (v_writer.m_data != v_case.m_expected)
+		{
+			std::cout << v_case.m_name << ": the bytes differ\n";
+			for (std::size_t a = 0; a < v_writer.m_data.size(); a++)
+				std::printf("0x%02X,%s", v_writer.m_data[a], ((a & 15) == 15) ? "\n" : " ");
+			std::printf("\n");
+
+			v_success = false;
+		}
+	}
+
+	if (v_success)
+		std::cout << "ok\n";
+
+	return v_success ? 0 : 1;
+}
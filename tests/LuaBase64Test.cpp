@@ -0,0 +1,127 @@
+// Compares LuaBase64 with base64_encode/base64_decode of Dependencies for every kernel the CPU
+// supports. The lengths cover every tail the SSSE3 and AVX2 kernels leave to the next kernel.
+
+#include "LuaBase64.hpp"
+
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include <base64.h>
+
+// A few blocks of the AVX2 kernel, which reads 32 characters and writes 24 bytes at a time
+static constexpr std::size_t MaxTestSize = 24 * 8 + 3;
+
+static const char* GetKernelName(LuaBase64::Kernel kernel)
+{
+	switch (kernel)
+	{
+	case LuaBase64::Kernel_Scalar: return "Scalar";
+	case LuaBase64::Kernel_SSSE3:  return "SSSE3";
+	case LuaBase64::Kernel_AVX2:   return "AVX2";
+	default:                       return "Unknown";
+	}
+}
+
+static bool DecodeMatches(const std::string& encoded, const std::vector<std::uint8_t>& expected, LuaBase64::Kernel kernel)
+{
+	std::vector<std::uint8_t> v_decoded(LuaBase64::GetMaxDecodedSize(encoded.size()));
+	std::size_t v_decoded_sz = 0;
+	if (!LuaBase64::Decode(encoded, v_decoded.data(), v_decoded_sz, kernel))
+		return false;
+
+	v_decoded.resize(v_decoded_sz);
+	return v_decoded == expected;
+}
+
+static bool TestKernel(LuaBase64::Kernel kernel, std::mt19937& rng)
+{
+	bool v_success = true;
+	const auto v_fail = [&v_success, kernel](const char* what, std::size_t size)
+	{
+		std::cout << GetKernelName(kernel) << ": " << what << " with " << size << " bytes\n";
+		v_success = false;
+	};
+
+	for (std::size_t v_size = 0; v_size <= MaxTestSize; v_size++)
+	{
+		std::vector<std::uint8_t> v_data(v_size);
+		for (std::uint8_t& v_byte : v_data)
+			v_byte = std::uint8_t(rng());
+
+		const std::string v_expected = base64_encode(v_data.data(), v_data.size());
+
+		std::string v_encoded(LuaBase64::GetEncodedSize(v_size), '\0');
+		LuaBase64::Encode(v_data, v_encoded.data(), kernel);
+		if (v_encoded != v_expected)
+			v_fail("Encode differs from base64_encode", v_size);
+
+		if (base64_decode(v_expected) != std::string(v_data.begin(), v_data.end()))
+			v_fail("base64_decode doesn't return the input", v_size);
+
+		if (!DecodeMatches(v_expected, v_data, kernel))
+			v_fail("Decode differs from base64_decode", v_size);
+
+		// The variants base64_decode accepts as well
+		if (!DecodeMatches(base64_encode(v_data.data(), v_data.size(), true), v_data, kernel))
+			v_fail("Decode of the url alphabet differs", v_size);
+
+		std::string v_unpadded = v_expected;
+		while (!v_unpadded.empty() && v_unpadded.back() == '=')
+			v_unpadded.pop_back();
+
+		if (!DecodeMatches(v_unpadded, v_data, kernel))
+			v_fail("Decode without padding differs", v_size);
+
+		// Every character outside of the alphabet has to be found, wherever it lands in the blocks
+		for (std::size_t v_pos = 0; v_pos < v_unpadded.size(); v_pos++)
+		{
+			std::string v_invalid = v_expected;
+			v_invalid[v_pos] = '!';
+
+			bool v_ref_throws = false;
+			try
+			{
+				base64_decode(v_invalid);
+			}
+			catch (const std::runtime_error&)
+			{
+				v_ref_throws = true;
+			}
+
+			std::vector<std::uint8_t> v_decoded(LuaBase64::GetMaxDecodedSize(v_invalid.size()));
+			std::size_t v_decoded_sz = 0;
+			if (LuaBase64::Decode(v_invalid, v_decoded.data(), v_decoded_sz, kernel) || !v_ref_throws)
+			{
+				v_fail("Invalid character isn't rejected", v_size);
+				break;
+			}
+		}
+	}
+
+	return v_success;
+}
+
+int main()
+{
+	std::mt19937 v_rng(1234);
+	bool v_success = true;
+
+	const LuaBase64::Kernel v_kernels[] = { LuaBase64::Kernel_Scalar, LuaBase64::Kernel_SSSE3, LuaBase64::Kernel_AVX2 };
+	for (const LuaBase64::Kernel v_kernel : v_kernels)
+	{
+		// Encode and Decode fall back to the best kernel the CPU has, which was tested already
+		if (v_kernel > LuaBase64::GetKernel())
+		{
+			std::cout << GetKernelName(v_kernel) << ": not supported by the CPU, skipped\n";
+			continue;
+		}
+
+		if (TestKernel(v_kernel, v_rng))
+			std::cout << GetKernelName(v_kernel) << ": ok\n";
+		else
+			v_success = false;
+	}
+
+	return v_success ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+// Reads and writes JSON documents with LuaJson and compares them with the expected trees.
+
+#include "LuaJson.hpp"
+
+#include <iostream>
+#include <string>
+
+static bool g_success = true;
+
+static void ExpectRead(const char* name, std::string_view json, const LuaData& expected, const JsonReadOptions& options)
+{
+	LuaData v_data;
+	if (!LuaJson::Read(json, v_data, options))
+	{
+		std::cout << name << ": Read failed\n";
+		g_success = false;
+		return;
+	}
+
+	if (!(v_data == expected))
+	{
+		std::cout << name << ": Read returned a different tree\n";
+		g_success = false;
+	}
+}
+
+static void ExpectRoundTrip(const char* name, const LuaData& data, const JsonReadOptions& options)
+{
+	std::string v_json;
+	if (!LuaJson::Write(data, v_json))
+	{
+		std::cout << name << ": Write failed\n";
+		g_success = false;
+		return;
+	}
+
+	ExpectRead(name, v_json, data, options);
+}
+
+static void TestIntegerKeys()
+{
+	JsonReadOptions v_options;
+	v_options.m_parseIntegerKeys = true;
+
+	// Only keys written the way writeInteger writes them and within the range of Int32 become integers.
+	// Keys out of range used to become garbage integers, so two of them could overwrite each other
+	const LuaData v_expected(LuaData::TableType{
+		{ LuaData(std::int32_t(1)), LuaData(std::int32_t(1)) },
+		{ LuaData(std::int32_t(-5)), LuaData(std::int32_t(2)) },
+		{ LuaData("01"), LuaData(std::int32_t(3)) },
+		{ LuaData("-0"), LuaData(std::int32_t(4)) },
+		{ LuaData(std::int32_t(2147483647)), LuaData(std::int32_t(5)) },
+		{ LuaData("2147483648"), LuaData(std::int32_t(6)) },
+		{ LuaData(std::int32_t(-2147483647 - 1)), LuaData(std::int32_t(7)) },
+		{ LuaData("-2147483649"), LuaData(std::int32_t(8)) },
+		{ LuaData("99999999999"), LuaData(std::int32_t(9)) },
+		{ LuaData("99999999998"), LuaData(std::int32_t(10)) },
+		{ LuaData("12a"), LuaData(std::int32_t(11)) }
+	});
+
+	ExpectRead("Integer keys",
+		R"({"1":1,"-5":2,"01":3,"-0":4,"2147483647":5,"2147483648":6,"-2147483648":7,"-2147483649":8,)"
+		R"("99999999999":9,"99999999998":10,"12a":11})",
+		v_expected, v_options);
+
+	// Without the option every key stays a string
+	ExpectRead("String keys", R"({"1":1,"99999999999":2})",
+		LuaData(LuaData::TableType{
+			{ LuaData("1"), LuaData(std::int32_t(1)) },
+			{ LuaData("99999999999"), LuaData(std::int32_t(2)) }
+		}),
+		JsonReadOptions());
+}
+
+static void TestRoundTrip()
+{
+	JsonReadOptions v_options;
+	v_options.m_parseIntegerKeys = true;
+
+	ExpectRoundTrip("Array", LuaData(LuaData::TableType{
+		{ LuaData(std::int32_t(1)), LuaData("first") },
+		{ LuaData(std::int32_t(2)), LuaData(2.5f) },
+		{ LuaData(std::int32_t(3)), LuaData(true) }
+	}), v_options);
+
+	ExpectRoundTrip("Nested", LuaData(LuaData::TableType{
+		{ LuaData("name"), LuaData("quote \" backslash \\ newline \n tab \t") },
+		{ LuaData(std::int32_t(-7)), LuaData(LuaData::TableType{
+			{ LuaData("inner"), LuaData(std::int32_t(-2147483647 - 1)) }
+		}) }
+	}), v_options);
+}
+
+int main()
+{
+	TestIntegerKeys();
+	TestRoundTrip();
+
+	if (g_success)
+		std::cout << "ok\n";
+
+	return g_success ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Serializes and deserializes random trees with thread pools of several sizes and compares the
+// result with the one of the sequential path. The chunks written on different threads are
+// stitched together at any bit position, so the blobs have to match byte for byte.
+
+#include "LuaData.hpp"
+#include "LuaThreadPool.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+
+// Big enough that the tables are split into chunks, see LuaData::ParallelMinCount
+static constexpr std::size_t BigTableSize = 3000;
+
+static LuaData MakeValue(std::mt19937& rng, std::size_t depth);
+
+static LuaData MakeString(std::mt19937& rng)
+{
+	// Small strings are stored inside of the value, longer ones are allocated
+	std::string v_string(rng() % 24, '\0');
+	for (char& v_char : v_string)
+		v_char = char('a' + rng() % 26);
+
+	return LuaData(v_string);
+}
+
+static LuaData MakeTable(std::mt19937& rng, std::size_t size, std::size_t depth)
+{
+	LuaData::TableType v_table;
+
+	// An array part followed by keys of every type, which end up in the hash part
+	const std::size_t v_array_size = size / 2;
+	for (std::size_t a = 1; a <= v_array_size; a++)
+		v_table[LuaData(std::int32_t(a))] = MakeValue(rng, depth + 1);
+
+	while (v_table.size() < size)
+	{
+		LuaData v_key;
+		switch (rng() % 4)
+		{
+		case 0:  v_key = MakeString(rng); break;
+		case 1:  v_key = LuaData(-std::int32_t(rng() % 100000)); break;
+		case 2:  v_key = LuaData(float(rng() % 1000) + 0.5f); break;
+		default: v_key = LuaData(std::int32_t(v_array_size + 2 + rng() % 100000)); break;
+		}
+
+		v_table[std::move(v_key)] = MakeValue(rng, depth + 1);
+	}
+
+	return LuaData(std::move(v_table));
+}
+
+static LuaData MakeValue(std::mt19937& rng, std::size_t depth)
+{
+	switch (rng() % 10)
+	{
+	case 0: return LuaData(bool(rng() & 1));
+	case 1: return LuaData(float(std::int32_t(rng() % 20001) - 10000) / 8.0f);
+	case 2: return LuaData(std::int32_t(rng()));
+	case 3: return LuaData(std::int16_t(rng()));
+	case 4: return LuaData(std::int8_t(rng()));
+	case 5:
+	{
+		LuaData v_json = MakeString(rng);
+		v_json.m_type = DataType_Json;
+		return v_json;
+	}
+	case 6:
+		// Mostly small tables, now and then another big one
+		if (depth < 3)
+			return MakeTable(rng, (rng() % 64 == 0) ? BigTableSize : rng() % 6, depth);
+
+		return LuaData(std::int32_t(depth));
+	default:
+		return MakeString(rng);
+	}
+}
+
+int main()
+{
+	std::mt19937 v_rng(4321);
+	bool v_success = true;
+
+	LuaThreadPool v_pools[] = { LuaThreadPool(1), LuaThreadPool(2), LuaThreadPool(4), LuaThreadPool(8) };
+	const FormatVersion v_versions[] = { FormatVersion_1, FormatVersion_2, FormatVersion_3 };
+
+	for (std::size_t v_tree_idx = 0; v_tree_idx < 4; v_tree_idx++)
+	{
+		const LuaData v_tree = MakeTable(v_rng, BigTableSize + v_tree_idx * 1000, 0);
+
+		for (const FormatVersion v_version : v_versions)
+		{
+			for (const bool v_compress : { false, true })
+			{
+				const auto v_fail = [&v_success, v_tree_idx, v_version, v_compress](const char* what, std::size_t thread_count)
+				{
+					std::cout << "Tree " << v_tree_idx << ", version " << v_version << (v_compress ? ", compressed" : "")
+						<< ", " << thread_count << " threads: " << what << "\n";
+					v_success = false;
+				};
+
+				std::vector<std::uint8_t> v_expected;
+				if (!LuaData::Serialize(v_tree, v_expected, v_compress, v_version))
+				{
+					v_fail("Sequential Serialize failed", 0);
+					continue;
+				}
+
+				LuaData v_decoded;
+				if (!LuaData::Deserialize(std::as_bytes(std::span(v_expected)), v_decoded, v_compress) || !(v_decoded == v_tree))
+					v_fail("Sequential Deserialize doesn't return the tree", 0);
+
+				for (LuaThreadPool& v_pool : v_pools)
+				{
+					const std::size_t v_thread_count = v_pool.getThreadCount();
+
+					std::vector<std::uint8_t> v_blob;
+					if (!LuaData::Serialize(v_tree, v_blob, v_compress, v_version, &v_pool))
+						v_fail("Serialize failed", v_thread_count);
+					else if (v_blob != v_expected)
+						v_fail("Serialize differs from the sequential blob", v_thread_count);
+
+					LuaData v_pool_decoded;
+					if (!LuaData::Deserialize(std::as_bytes(std::span(v_expected)), v_pool_decoded, v_compress,
+						std::pmr::get_default_resource(), nullptr, &v_pool) || !(v_pool_decoded == v_tree))
+					{
+						v_fail("Deserialize doesn't return the tree", v_thread_count);
+					}
+				}
+			}
+		}
+	}
+
+	if (v_success)
+		std::cout << "ok\n";
+
+	return v_success ? 0 : 1;
+}
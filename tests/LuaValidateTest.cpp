@@ -0,0 +1,176 @@
+// LuaData::Validate has to accept exactly the blobs LuaData::Deserialize accepts. Both are fed
+// valid blobs of random trees, and the same blobs truncated, with flipped bits and with
+// malformed varints.
+
+#include "LuaData.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+
+static LuaData MakeValue(std::mt19937& rng, std::size_t depth)
+{
+	switch (rng() % ((depth > 3) ? 9 : 11))
+	{
+	case 0: return LuaData(nullptr);
+	case 1: return LuaData(bool(rng() & 1));
+	case 2: return LuaData(float(std::int32_t(rng() % 100000)) / 8.0f);
+	case 3: return LuaData(std::int32_t(rng()));
+	case 4: return LuaData(std::int16_t(rng()));
+	case 5: return LuaData(std::int8_t(rng()));
+	case 6:
+	{
+		LuaData v_json("{\"a\":1}");
+		v_json.m_type = DataType_Json;
+		return v_json;
+	}
+	case 7:
+	case 8:
+	{
+		std::string v_string(rng() % 32, '\0');
+		for (char& v_char : v_string)
+			v_char = char('a' + rng() % 26);
+
+		return LuaData(v_string);
+	}
+	default:
+	{
+		LuaData::TableType v_table;
+
+		const std::size_t v_size = rng() % ((depth < 2) ? 40 : 12);
+		const bool v_is_array = rng() % 3 == 0;
+		for (std::size_t a = 0; a < v_size; a++)
+		{
+			if (v_is_array)
+				v_table[LuaData(std::int32_t(a + 1))] = MakeValue(rng, depth + 1);
+			else
+				v_table[MakeValue(rng, 5)] = MakeValue(rng, depth + 1);
+		}
+
+		return LuaData(std::move(v_table));
+	}
+	}
+}
+
+struct ValidateTest
+{
+	std::size_t m_blobCount = 0;
+	std::size_t m_validCount = 0;
+	bool m_success = true;
+
+	// Returns whether the blob is valid
+	bool check(const std::vector<std::uint8_t>& blob, bool is_compressed, const char* what)
+	{
+		// Deserialize prints why it failed, which isn't of interest here
+		std::streambuf* v_cout_buf = std::cout.rdbuf(nullptr);
+
+		ValidateResult v_result;
+		const bool v_is_valid = LuaData::Validate(std::as_bytes(std::span(blob)), is_compressed, ValidateLimits(), v_result);
+
+		LuaData v_data;
+		const bool v_is_decoded = LuaData::Deserialize(std::as_bytes(std::span(blob)), v_data, is_compressed);
+
+		std::cout.rdbuf(v_cout_buf);
+
+		m_blobCount++;
+		m_validCount += v_is_valid;
+
+		if (v_is_valid != v_is_decoded)
+		{
+			std::cout << what << ": Validate returned " << v_is_valid << ", Deserialize " << v_is_decoded << "\n";
+			m_success = false;
+		}
+
+		return v_is_valid;
+	}
+};
+
+int main()
+{
+	std::mt19937 v_rng(77);
+	ValidateTest v_test;
+
+	const FormatVersion v_versions[] = { FormatVersion_1, FormatVersion_2, FormatVersion_3 };
+
+	for (std::size_t v_tree_idx = 0; v_tree_idx < 300; v_tree_idx++)
+	{
+		const LuaData v_tree = MakeValue(v_rng, 0);
+
+		for (const FormatVersion v_version : v_versions)
+		{
+			for (const bool v_compress : { false, true })
+			{
+				std::vector<std::uint8_t> v_blob;
+				if (!LuaData::Serialize(v_tree, v_blob, v_compress, v_version))
+					continue;
+
+				v_test.check(v_blob, v_compress, "Valid blob");
+
+				// Cut off anywhere, including within the header
+				for (std::size_t v_size = 0; v_size < v_blob.size(); v_size += 1 + v_rng() % 7)
+					v_test.check(std::vector<std::uint8_t>(v_blob.begin(), v_blob.begin() + v_size), v_compress, "Truncated blob");
+
+				for (std::size_t a = 0; a < 8; a++)
+				{
+					std::vector<std::uint8_t> v_flipped = v_blob;
+					for (std::size_t v_flip_count = 1 + v_rng() % 3; v_flip_count > 0; v_flip_count--)
+						v_flipped[v_rng() % v_flipped.size()] ^= std::uint8_t(1 << (v_rng() % 8));
+
+					v_test.check(v_flipped, v_compress, "Flipped bits");
+				}
+
+				// Continuation bits all over the place make varints of FormatVersion_3 run past
+				// their 10th group, and the groups around them values that don't fit
+				if (v_version >= FormatVersion_3 && !v_compress && v_blob.size() > 8)
+				{
+					for (std::size_t a = 0; a < 8; a++)
+					{
+						std::vector<std::uint8_t> v_malformed = v_blob;
+						const std::size_t v_start = 7 + v_rng() % (v_malformed.size() - 7);
+						const std::size_t v_end = std::min(v_malformed.size(), v_start + 1 + v_rng() % 12);
+						for (std::size_t v_idx = v_start; v_idx < v_end; v_idx++)
+							v_malformed[v_idx] = 0xFF;
+
+						v_test.check(v_malformed, false, "Malformed varints");
+					}
+				}
+			}
+		}
+	}
+
+	// Varints that are complete but malformed, right after the header of a FormatVersion_3 blob
+	std::vector<std::uint8_t> v_nil_blob;
+	LuaData::Serialize(LuaData(nullptr), v_nil_blob, false, FormatVersion_3);
+	const std::vector<std::uint8_t> v_header(v_nil_blob.begin(), v_nil_blob.begin() + 7);
+
+	const auto v_check_value = [&v_test, &v_header](DataType type, std::initializer_list<std::uint8_t> bytes, bool is_valid,
+		const char* what)
+	{
+		BitWriter v_writer;
+		// FormatVersion_3 writes the type as 4 bits
+		v_writer.writeValue(type, 4);
+		for (const std::uint8_t v_byte : bytes)
+			v_writer.writeValue(v_byte, 8);
+		v_writer.flush();
+
+		std::vector<std::uint8_t> v_blob = v_header;
+		v_blob.insert(v_blob.end(), v_writer.m_data.begin(), v_writer.m_data.end());
+		if (v_test.check(v_blob, false, what) != is_valid)
+		{
+			std::cout << what << ": " << (is_valid ? "rejected" : "accepted") << "\n";
+			v_test.m_success = false;
+		}
+	};
+
+	v_check_value(DataType_Int32, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02 }, false, "Bad 10th group");
+	v_check_value(DataType_String, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, false, "10 groups without an end");
+	v_check_value(DataType_String, { 0xFF, 0xFF, 0xFF, 0xFF, 0x7F }, false, "Size above std::uint32_t");
+	v_check_value(DataType_Int8, { 0x80, 0x04 }, false, "Int8 out of range");
+	v_check_value(DataType_Int16, { 0x80, 0x80, 0x08 }, false, "Int16 out of range");
+	v_check_value(DataType_Int8, { 0x04 }, true, "Valid Int8");
+
+	if (v_test.m_success)
+		std::cout << "ok, " << v_test.m_blobCount << " blobs, " << v_test.m_validCount << " valid\n";
+
+	return v_test.m_success ? 0 : 1;
+}